@@ -24,6 +24,30 @@ build$(M)/pw_config_utils.o: pw_config_utils.c
 	@$(shell mkdir -p build$(M))
 	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
 
+build$(M)/pw_handoff.o: pw_handoff.c pw_handoff.h
+	@$(shell mkdir -p build$(M))
+	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
+
+build$(M)/pw_arena.o: pw_arena.c pw_arena.h
+	@$(shell mkdir -p build$(M))
+	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
+
+build$(M)/pw_cycle.o: pw_cycle.c pw_cycle.h pw_block_adapter.h pw_interleave.h pw_convert.h
+	@$(shell mkdir -p build$(M))
+	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
+
+build$(M)/pw_convert.o: pw_convert.c pw_convert.h
+	@$(shell mkdir -p build$(M))
+	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
+
+build$(M)/pw_asio_log.o: pw_asio_log.c pw_asio_log.h
+	@$(shell mkdir -p build$(M))
+	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
+
+build$(M)/pw_stats.o: pw_stats.c pw_stats.h
+	@$(shell mkdir -p build$(M))
+	$(CC) -c $(INCLUDE_PATH) $(CFLAGS) $(CEXTRA) -o $@ $<
+
 PREFIX                = /usr
 SRCDIR                = .
 DLLS                  = $(wineasio_dll_MODULE) $(wineasio_dll_MODULE).so
@@ -86,7 +110,7 @@ wineasio_dll_DLLS     = odbc32 \
 			winmm
 wineasio_dll_LIBRARIES = uuid
 
-wineasio_dll_OBJS     = $(wineasio_dll_C_SRCS:%.c=build$(M)/%.c.o) build$(M)/pw_helper.o build$(M)/pw_config_utils.o
+wineasio_dll_OBJS     = $(wineasio_dll_C_SRCS:%.c=build$(M)/%.c.o) build$(M)/pw_helper.o build$(M)/pw_config_utils.o build$(M)/pw_handoff.o build$(M)/pw_arena.o build$(M)/pw_cycle.o build$(M)/pw_convert.o build$(M)/pw_asio_log.o build$(M)/pw_stats.o
 
 ### Global source lists
 
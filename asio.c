@@ -33,6 +33,7 @@
 #include <sys/mman.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <time.h>
 
 #include <jack/jack.h>
 #include <jack/thread.h>
@@ -41,7 +42,9 @@
 #include <spa/param/buffers.h>
 #include <spa/param/latency-utils.h>
 #include <spa/pod/builder.h>
+#include <spa/pod/iter.h>
 #include <spa/buffer/buffer.h>
+#include <spa/node/io.h>
 #include <pipewire/buffers.h>
 #include <pipewire/context.h>
 #include <pipewire/filter.h>
@@ -50,6 +53,13 @@
 #include "gui/gui_stub.inc.c"
 #include "pw_helper_c.h"
 #include "pw_helper_common.h"
+#include "pw_handoff.h"
+#include "pw_block_adapter.h"
+#include "pw_cycle.h"
+#include "pw_convert.h"
+#include "pw_arena.h"
+#include "pw_asio_log.h"
+#include "pw_stats.h"
 #include "driver_clsid.h"
 
 /* Performance optimization macros */
@@ -87,6 +97,10 @@ WINE_DEFAULT_DEBUG_CHANNEL(asio);
 #define ASIO_MAXIMUM_BUFFERSIZE     8192
 #define ASIO_PREFERRED_BUFFERSIZE   1024
 
+/* Port names in interleaved mode */
+#define INTERLEAVED_INPUT_PORT      "input"
+#define INTERLEAVED_OUTPUT_PORT     "output"
+
 #define ASIO_LONG(typ, x) ({ uint64_t __long_val = (x); (typ) { .lo = (uint32_t)__long_val, .hi = (uint32_t)(__long_val >> 32) }; })
 
 /* ASIO drivers (breaking the COM specification) use the Microsoft variety of
@@ -162,19 +176,6 @@ DECLARE_INTERFACE_(IWineASIO,IUnknown)
 
 typedef struct IWineASIO *LPWINEASIO;
 
-typedef struct IOChannel
-{
-    bool                         active;
-    char                         port_name[ASIO_MAX_NAME_LENGTH];
-    void                        *port;
-    struct pw_buffer            *buffers[2];
-    
-    /* Wine-compatible buffer management */
-    void                        *wine_buffers[2];  /* Wine-allocated buffers */
-    size_t                       buffer_size;      /* Size of each buffer in bytes */
-    bool                         needs_copy;       /* Whether data copying is needed */
-} IOChannel;
-
 #define DEVICE_NAME_SIZE 1024
 
 typedef struct IWineASIOImpl
@@ -192,7 +193,6 @@ typedef struct IWineASIOImpl
     /* ASIO stuff */
     LONG                        asio_active_inputs;
     LONG                        asio_active_outputs;
-    bool                        asio_buffer_index;
     ASIOCallbacks               *asio_callbacks;
     LONG                        asio_current_buffersize;
     INT                         asio_driver_state;
@@ -213,6 +213,83 @@ typedef struct IWineASIOImpl
     LONG                        wineasio_preferred_buffersize;
     WCHAR                       pwasio_input_device_name[DEVICE_NAME_SIZE];
     WCHAR                       pwasio_output_device_name[DEVICE_NAME_SIZE];
+    enum pw_handoff_wakeup      pwasio_callback_wakeup;
+    uint32_t                    pwasio_callback_spin_us;
+    bool                        pwasio_direct_dispatch;
+    bool                        pwasio_zero_copy;
+    enum pw_cycle_late_policy   pwasio_late_policy;
+    bool                        pwasio_force_graph_clock;
+    bool                        pwasio_interleaved_ports;
+    enum pw_sample_format       pwasio_input_format;
+    enum pw_sample_format       pwasio_output_format;
+
+    /* Direct dispatch state, see dispatch_asio_callback() */
+    bool                        direct_dispatch_disabled;
+    uint32_t                    direct_dispatch_overruns;
+    /* Set when Stop() ran inside a direct bufferSwitch and could not
+     * deactivate the filter, see deactivate_stopped_filter() */
+    bool                        filter_left_active;
+
+    /* Deadline and xrun tracking, see pipewire_process_callback(). The data
+     * thread queues host notifications in `pending_messages` for
+     * deliver_host_messages(). */
+    uint64_t                    cycle_deadline_ns;
+    uint64_t                    cycle_next_position;
+    uint32_t                    deadline_misses;
+    uint32_t                    pending_messages;
+    uint64_t                    last_resync_ns;
+    uint64_t                    last_overload_ns;
+    bool                        host_handles_resync;
+    bool                        host_handles_overload;
+    bool                        host_handles_latencies;
+    bool                        host_handles_buffer_size;
+    bool                        host_handles_reset;
+
+    /* Graph clock changes the host has to follow, see follow_graph_clock().
+     * `settings_*` are the last values of the settings metadata, `next_*`
+     * what the host is asked to switch to. The next buffer size takes effect
+     * in DisposeBuffers(), the next rate at the next Start() or
+     * DisposeBuffers(). */
+    uint32_t                    settings_quantum;
+    uint32_t                    settings_rate;
+    uint32_t                    next_buffersize;
+    uint32_t                    next_sample_rate;
+
+    /* Graph clock and adapter head start behind the reported latencies,
+     * written by the data thread. `reported_*` is what the host last got
+     * from GetLatencies(). */
+    uint32_t                    graph_quantum;
+    uint32_t                    graph_rate;
+    uint32_t                    graph_adapter_latency;
+    LONG                        reported_input_latency;
+    LONG                        reported_output_latency;
+    /* What the ports last published to the graph, see publish_port_latencies() */
+    struct spa_latency_info     published_capture;
+    struct spa_latency_info     published_playback;
+    /* Set while our node properties ask for the host's clock, see
+     * request_graph_clock() */
+    bool                        graph_clock_requested;
+
+    /* Per-cycle copy/dispatch state, see pw_cycle.h */
+    struct pw_cycle             cycle;
+
+    /* Set when the port buffers behind a zero-copy channel went away; the
+     * host is not called again until it re-creates its buffers */
+    bool                        zero_copy_lost;
+    /* Set while an output that could be zero-copy copies because its port
+     * had no buffers yet, see pipewire_add_buffer_callback() */
+    bool                        zero_copy_waiting;
+
+    /* Host buffers of all copying channels, see alloc_buffer_arena() */
+    struct pw_arena             buffer_arena;
+    bool                        pwasio_hugepages;
+
+    /* Live statistics for pipewine-stat. `stats_cycle` collects what the
+     * current graph cycle adds and is only touched by the data thread. */
+    struct pw_stats             stats;
+    struct pw_stats_cycle       stats_cycle;
+    uint64_t                    stats_last_start;
+    bool                        pwasio_stats;
 
     /* PipeWire stuff */
     struct user_pw_helper *pw_helper;
@@ -235,9 +312,6 @@ typedef struct IWineASIOImpl
     //jack_default_audio_sample_t *callback_audio_buffer;
     IOChannel                   *input_channel;
     IOChannel                   *output_channel;
-
-    uint32_t                     asio_buffers_left_to_init;
-    pthread_barrier_t            asio_buffers_filled;
 } IWineASIOImpl;
 
 enum { Loaded, Initialized, Prepared, Running };
@@ -317,6 +391,7 @@ static inline int  jack_sample_rate_callback (jack_nframes_t nframes, void *arg)
 HRESULT WINAPI  WineASIOCreateInstance(REFIID riid, LPVOID *ppobj, IUnknown *cls_factory);
 static  void    store_config(IWineASIOImpl *This);
 static  VOID    configure_driver(IWineASIOImpl *This);
+static  VOID    read_driver_config(IWineASIOImpl *This);
 static  void    get_nodes_by_name(IWineASIOImpl *This);
 
 HIDDEN void GuiClosed(struct pwasio_gui_conf *conf);
@@ -363,6 +438,18 @@ struct {
     HANDLE      jack_callback_thread_created;
 } jack_thread_creator_privates;
 
+/* Set on threads started through jack_thread_creator_helper(), i.e. threads
+ * Wine knows about and that may call into the ASIO host directly */
+static __thread bool tls_wine_created_thread;
+/* Set while the data thread is inside a directly dispatched host callback */
+static __thread bool tls_in_direct_callback;
+
+static inline uint64_t monotonic_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 /* ASIO callback marshalling system for Wine thread context */
 typedef struct {
     IWineASIOImpl *This;
@@ -370,9 +457,12 @@ typedef struct {
     ASIOBool direct_process;
     ASIOTime asio_time;
     bool use_time_info;
-    HANDLE callback_event;
-    HANDLE callback_completed;
-    volatile bool callback_pending;
+    /* When the request was posted, written by the data thread, and how long
+     * the callback thread took to call the host and how long the host spent
+     * in bufferSwitch, written by the callback thread */
+    uint64_t posted_ns;
+    uint64_t wakeup_ns;
+    uint64_t host_ns;
     volatile bool thread_should_exit;
 } ASIOCallbackData;
 
@@ -380,58 +470,210 @@ typedef struct {
     HANDLE callback_thread;
     DWORD callback_thread_id;
     ASIOCallbackData callback_data;
-    CRITICAL_SECTION callback_lock;
+    struct pw_handoff handoff;
 } ASIOCallbackManager;
 
 static ASIOCallbackManager g_callback_manager = {0};
 
+/* Win32 auto-reset events for the "event" wakeup backend */
+static void *win32_event_create(void) {
+    return CreateEventW(NULL, FALSE, FALSE, NULL);
+}
+
+static void win32_event_signal(void *event) {
+    SetEvent(event);
+}
+
+static int win32_event_wait(void *event, int timeout_ms) {
+    switch (WaitForSingleObject(event, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms)) {
+        case WAIT_OBJECT_0: return 0;
+        case WAIT_TIMEOUT: return 1;
+        default: return -1;
+    }
+}
+
+static void win32_event_destroy(void *event) {
+    CloseHandle(event);
+}
+
+static struct pw_handoff_event_ops const win32_event_ops = {
+    .create = win32_event_create,
+    .signal = win32_event_signal,
+    .wait = win32_event_wait,
+    .destroy = win32_event_destroy,
+};
+
+/* bufferSwitch has to be done this far into the graph period */
+#define CALLBACK_DEADLINE_PERCENT   90
+/* A freewheeling graph waits for us; only guard against a hung host */
+#define FREEWHEEL_DEADLINE_NS       1000000000ULL
+/* Each kind of host notification is sent at most this often */
+#define HOST_MESSAGE_INTERVAL_NS    1000000000ULL
+
+/* Notifications queued by the data thread */
+#define PENDING_RESYNC              (1u << 0)
+#define PENDING_OVERLOAD            (1u << 1)
+#define PENDING_LATENCIES           (1u << 2)
+#define PENDING_BUFFER_SIZE         (1u << 3)
+#define PENDING_SAMPLE_RATE         (1u << 4)
+#define PENDING_RESET               (1u << 5)
+
+static inline void post_host_message(IWineASIOImpl *This, uint32_t message) {
+    __atomic_fetch_or(&This->pending_messages, message, __ATOMIC_RELEASE);
+}
+
+/* The graph clock moved away from the host's, see follow_graph_clock(). A
+ * new rate is reported with sampleRateDidChange(); asio_sample_rate, which
+ * the data thread reads every cycle, takes it only between Stop() and
+ * Start() (see apply_next_sample_rate()). A new buffer size is
+ * offered with kAsioBufferSizeChange, and becomes the preferred one for hosts
+ * that choose their own. When the host does not take it, or after a rate
+ * change, it is asked to reset: it then disposes and re-creates its buffers,
+ * and CreateBuffers() requests the new clock from the graph. */
+static void deliver_graph_clock(IWineASIOImpl *This, uint32_t pending) {
+    uint32_t buffersize = __atomic_load_n(&This->next_buffersize, __ATOMIC_RELAXED);
+    uint32_t rate = __atomic_load_n(&This->next_sample_rate, __ATOMIC_RELAXED);
+    bool reset = false;
+
+    if ((pending & PENDING_SAMPLE_RATE) && rate && rate != (uint32_t)This->asio_sample_rate) {
+        printf("Graph rate changed to %u Hz, was %.0f Hz\n", rate, This->asio_sample_rate);
+        This->asio_callbacks->sampleRateDidChange(rate);
+        reset = true;
+    }
+    if ((pending & PENDING_BUFFER_SIZE) && buffersize && buffersize != (uint32_t)This->asio_current_buffersize) {
+        printf("Graph quantum changed to %u, host buffers have %d samples\n",
+               buffersize, (int)This->asio_current_buffersize);
+        This->wineasio_preferred_buffersize = buffersize;
+        if (!This->host_handles_buffer_size ||
+            !This->asio_callbacks->asioMessage(kAsioBufferSizeChange, buffersize, 0, 0))
+            reset = true;
+    }
+    if (!reset)
+        return;
+    if (This->host_handles_reset)
+        This->asio_callbacks->asioMessage(kAsioResetRequest, 0, 0, 0);
+    else
+        WARN("The host cannot be reset, it keeps running at %d samples and %.0f Hz\n",
+             (int)This->asio_current_buffersize, This->asio_sample_rate);
+}
+
+/* Send the notifications queued with post_host_message(). asioMessage() is
+ * not called from the PipeWire thread, so this runs on the Wine thread that
+ * is about to call bufferSwitch. Resync and overload go out at most once per
+ * HOST_MESSAGE_INTERVAL_NS so that a struggling host is not flooded; the
+ * ones in between are dropped. */
+static void deliver_host_messages(IWineASIOImpl *This) {
+    uint32_t pending;
+    uint64_t now;
+
+    if (likely(!__atomic_load_n(&This->pending_messages, __ATOMIC_RELAXED)))
+        return;
+    pending = __atomic_exchange_n(&This->pending_messages, 0, __ATOMIC_ACQUIRE);
+    now = monotonic_time_ns();
+
+    if ((pending & PENDING_RESYNC) && This->host_handles_resync &&
+        now - This->last_resync_ns >= HOST_MESSAGE_INTERVAL_NS) {
+        This->last_resync_ns = now;
+        This->asio_callbacks->asioMessage(kAsioResyncRequest, 0, 0, 0);
+    }
+    if ((pending & PENDING_OVERLOAD) && This->host_handles_overload &&
+        now - This->last_overload_ns >= HOST_MESSAGE_INTERVAL_NS) {
+        This->last_overload_ns = now;
+        This->asio_callbacks->asioMessage(kAsioOverload, 0, 0, 0);
+    }
+    if ((pending & PENDING_LATENCIES) && This->host_handles_latencies)
+        This->asio_callbacks->asioMessage(kAsioLatenciesChanged, 0, 0, 0);
+    if ((pending & PENDING_RESET) && This->host_handles_reset)
+        This->asio_callbacks->asioMessage(kAsioResetRequest, 0, 0, 0);
+    if (pending & (PENDING_BUFFER_SIZE | PENDING_SAMPLE_RATE))
+        deliver_graph_clock(This, pending);
+}
+
+/* The graph runs at `quantum` frames and `rate` Hz now (0: unchanged). The
+ * block adapter bridges a quantum that differs from the host's buffer size,
+ * and nothing bridges another rate, so either way the host is asked to
+ * follow. Our own requests from CreateBuffers()/SetSampleRate() update the
+ * host's clock, or the rate queued for it, first and never get here. Any
+ * thread. */
+static void follow_graph_clock(IWineASIOImpl *This, uint32_t quantum, uint32_t rate) {
+    if (This->asio_driver_state < Prepared)
+        return;
+    /* Back at the host's clock, a change still queued is void */
+    if (quantum == (uint32_t)This->asio_current_buffersize) {
+        __atomic_store_n(&This->next_buffersize, 0, __ATOMIC_RELAXED);
+    } else if (quantum >= ASIO_MINIMUM_BUFFERSIZE && quantum <= ASIO_MAXIMUM_BUFFERSIZE) {
+        __atomic_store_n(&This->next_buffersize, quantum, __ATOMIC_RELAXED);
+        post_host_message(This, PENDING_BUFFER_SIZE);
+    }
+    if (rate == (uint32_t)This->asio_sample_rate) {
+        __atomic_store_n(&This->next_sample_rate, 0, __ATOMIC_RELAXED);
+    } else if (rate && rate != __atomic_load_n(&This->next_sample_rate, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&This->next_sample_rate, rate, __ATOMIC_RELAXED);
+        post_host_message(This, PENDING_SAMPLE_RATE);
+    }
+}
+
+/* Settings metadata listener, on the PipeWire loop thread. The values seen
+ * first are only a baseline, a clock.quantum default that our node.latency
+ * overrides says nothing about the graph. Later changes to it, and forced
+ * values in particular, are what a user or another client wants the graph to
+ * run at. */
+static void graph_settings_changed(uint32_t quantum, uint32_t rate, void *userdata) {
+    IWineASIOImpl *This = (IWineASIOImpl*)userdata;
+    uint32_t old_quantum = This->settings_quantum, old_rate = This->settings_rate;
+
+    This->settings_quantum = quantum;
+    This->settings_rate = rate;
+    TRACE("Graph settings changed: quantum %u rate %u\n", quantum, rate);
+    follow_graph_clock(This, old_quantum && quantum != old_quantum ? quantum : 0,
+                       old_rate && rate != old_rate ? rate : 0);
+}
+
 /* Wine thread function for ASIO callbacks */
 static DWORD WINAPI asio_callback_thread_proc(LPVOID param) {
     ASIOCallbackManager *manager = (ASIOCallbackManager*)param;
     ASIOCallbackData *data = &manager->callback_data;
+    uint32_t ticket = 0;
     
     TRACE("ASIO callback thread started\n");
     printf("ASIO callback thread started in Wine context\n");
     
     while (!data->thread_should_exit) {
         /* Wait for callback request from PipeWire thread */
-        DWORD wait_result = WaitForSingleObject(data->callback_event, 1000); /* 1 second timeout */
-        
-        if (wait_result == WAIT_TIMEOUT) {
+        if (pw_handoff_wait_request(&manager->handoff, &ticket, 1000)) {
+            /* A lost zero-copy channel stops the buffer switches that would
+             * carry its reset request */
+            if (!data->thread_should_exit && data->This && data->This->asio_callbacks &&
+                __atomic_load_n(&data->This->zero_copy_lost, __ATOMIC_RELAXED))
+                deliver_host_messages(data->This);
             continue; /* Check exit condition */
         }
         
-        if (wait_result != WAIT_OBJECT_0 || data->thread_should_exit) {
+        if (data->thread_should_exit) {
             break;
         }
         
         /* Process the callback in Wine's thread context */
-        EnterCriticalSection(&manager->callback_lock);
-        
-        if (data->callback_pending && data->This && data->This->asio_callbacks) {
+        if (data->This && data->This->asio_callbacks) {
             IWineASIOImpl *This = data->This;
+            uint64_t start;
             
             TRACE("Executing ASIO callback in Wine thread context\n");
-            /* Verbose debug disabled for cleaner output */
-            /* printf("Executing ASIO callback: buffer_index=%d, time_info=%d\n", 
-                   data->buffer_index, data->use_time_info); */
+            deliver_host_messages(This);
             
             /* Call the ASIO callback in Wine's thread context */
+            start = monotonic_time_ns();
+            data->wakeup_ns = start - data->posted_ns;
             if (data->use_time_info && This->asio_time_info_mode) {
                 This->asio_callbacks->bufferSwitchTimeInfo(&data->asio_time, data->buffer_index, data->direct_process);
             } else {
                 This->asio_callbacks->bufferSwitch(data->buffer_index, data->direct_process);
             }
-            
-            /* Verbose debug disabled for cleaner output */
-            /* printf("ASIO callback completed successfully\n"); */
-            data->callback_pending = false;
+            data->host_ns = monotonic_time_ns() - start;
         }
         
-        LeaveCriticalSection(&manager->callback_lock);
-        
         /* Signal completion to PipeWire thread */
-        SetEvent(data->callback_completed);
+        pw_handoff_complete(&manager->handoff, ticket);
     }
     
     TRACE("ASIO callback thread exiting\n");
@@ -442,27 +684,30 @@ static DWORD WINAPI asio_callback_thread_proc(LPVOID param) {
 
 /* Initialize the ASIO callback manager */
 static BOOL init_asio_callback_manager(IWineASIOImpl *This) {
+    int res;
+
     if (g_callback_manager.callback_thread) {
         return TRUE; /* Already initialized */
     }
     
     TRACE("Initializing ASIO callback manager\n");
     /* Keep this one as it's important for initialization confirmation */
-    printf("Initializing ASIO callback manager for Wine thread marshalling\n");
-    
-    InitializeCriticalSection(&g_callback_manager.callback_lock);
+    printf("Initializing ASIO callback manager for Wine thread marshalling (wakeup: %s, spin: %u us)\n",
+           pw_handoff_wakeup_name(This->pwasio_callback_wakeup), This->pwasio_callback_spin_us);
     
     /* Initialize callback data */
     g_callback_manager.callback_data.This = This;
-    g_callback_manager.callback_data.callback_pending = false;
     g_callback_manager.callback_data.thread_should_exit = false;
     
-    /* Create synchronization events */
-    g_callback_manager.callback_data.callback_event = CreateEventW(NULL, FALSE, FALSE, NULL);
-    g_callback_manager.callback_data.callback_completed = CreateEventW(NULL, FALSE, FALSE, NULL);
-    
-    if (!g_callback_manager.callback_data.callback_event || 
-        !g_callback_manager.callback_data.callback_completed) {
+    /* Create the request/completion handoff */
+    res = pw_handoff_init(&g_callback_manager.handoff, This->pwasio_callback_wakeup,
+                          This->pwasio_callback_spin_us, &win32_event_ops);
+    if (res < 0) {
+        ERR("Failed to create %s callback handoff (%d), falling back to events\n",
+            pw_handoff_wakeup_name(This->pwasio_callback_wakeup), res);
+        res = pw_handoff_init(&g_callback_manager.handoff, PW_HANDOFF_WAKEUP_EVENT, 0, &win32_event_ops);
+    }
+    if (res < 0) {
         ERR("Failed to create callback synchronization events\n");
         return FALSE;
     }
@@ -474,9 +719,7 @@ static BOOL init_asio_callback_manager(IWineASIOImpl *This) {
     
     if (!g_callback_manager.callback_thread) {
         ERR("Failed to create ASIO callback thread\n");
-        CloseHandle(g_callback_manager.callback_data.callback_event);
-        CloseHandle(g_callback_manager.callback_data.callback_completed);
-        DeleteCriticalSection(&g_callback_manager.callback_lock);
+        pw_handoff_clear(&g_callback_manager.handoff);
         return FALSE;
     }
     
@@ -494,8 +737,6 @@ static BOOL init_asio_callback_manager(IWineASIOImpl *This) {
     }
     
     TRACE("ASIO callback manager initialized successfully\n");
-    /* Verbose debug disabled for cleaner output */
-    /* printf("ASIO callback manager initialized: thread_id=%lu\n", g_callback_manager.callback_thread_id); */
     return TRUE;
 }
 
@@ -508,22 +749,16 @@ static void cleanup_asio_callback_manager(void) {
     TRACE("Cleaning up ASIO callback manager\n");
     printf("Cleaning up ASIO callback manager\n");
     
-    /* Signal thread to exit */
-    EnterCriticalSection(&g_callback_manager.callback_lock);
+    /* Signal thread to exit and wake it up */
     g_callback_manager.callback_data.thread_should_exit = true;
-    LeaveCriticalSection(&g_callback_manager.callback_lock);
-    
-    /* Wake up the thread */
-    SetEvent(g_callback_manager.callback_data.callback_event);
+    pw_handoff_post(&g_callback_manager.handoff);
     
     /* Wait for thread to exit */
     WaitForSingleObject(g_callback_manager.callback_thread, 5000);
     
     /* Cleanup resources */
     CloseHandle(g_callback_manager.callback_thread);
-    CloseHandle(g_callback_manager.callback_data.callback_event);
-    CloseHandle(g_callback_manager.callback_data.callback_completed);
-    DeleteCriticalSection(&g_callback_manager.callback_lock);
+    pw_handoff_clear(&g_callback_manager.handoff);
     
     /* Reset manager */
     memset(&g_callback_manager, 0, sizeof(g_callback_manager));
@@ -531,24 +766,44 @@ static void cleanup_asio_callback_manager(void) {
     TRACE("ASIO callback manager cleaned up\n");
 }
 
-/* Marshal ASIO callback from PipeWire thread to Wine thread */
-static void marshal_asio_callback(IWineASIOImpl *This, LONG buffer_index, ASIOBool direct_process, 
+/* Account one bufferSwitch of `host_ns` to the current cycle's statistics */
+static inline void count_host_callback(IWineASIOImpl *This, uint64_t host_ns) {
+    struct pw_stats_cycle *stats = &This->stats_cycle;
+
+    if (!This->stats.segment)
+        return;
+    pw_stats_record(This->stats.segment, PW_STATS_HIST_HOST, host_ns);
+    stats->callbacks++;
+    stats->host_ns += host_ns;
+    if (host_ns > stats->host_max_ns)
+        stats->host_max_ns = host_ns;
+    if (host_ns * (uint64_t)This->asio_sample_rate > (uint64_t)This->asio_current_buffersize * 1000000000ULL)
+        stats->callback_overruns++;
+}
+
+/* Marshal ASIO callback from PipeWire thread to Wine thread. Returns false
+ * when the host was not done by the cycle deadline; it keeps the buffer half
+ * and the callback thread until it is, see pipewire_process_callback(). */
+static bool marshal_asio_callback(IWineASIOImpl *This, LONG buffer_index, ASIOBool direct_process, 
                                   ASIOTime *asio_time, bool use_time_info) {
+    uint64_t posted, wait_ns;
+    uint32_t ticket;
+    bool done;
+
+    /* This runs on the PipeWire data thread: report through the log ring,
+     * never printf */
     if (!g_callback_manager.callback_thread) {
-        ERR("ASIO callback manager not initialized\n");
-        return;
+        PWASIO_LOG_ERROR("ASIO callback manager not initialized\n");
+        return false;
     }
     
-    /* Prepare callback data */
-    EnterCriticalSection(&g_callback_manager.callback_lock);
-    
-    if (g_callback_manager.callback_data.callback_pending) {
+    if (!pw_handoff_idle(&g_callback_manager.handoff)) {
         /* Previous callback still pending - this shouldn't happen in normal operation */
-        WARN("Previous ASIO callback still pending, skipping\n");
-        LeaveCriticalSection(&g_callback_manager.callback_lock);
-        return;
+        PWASIO_LOG_WARNING("Previous ASIO callback still pending, skipping\n");
+        return false;
     }
     
+    /* Prepare callback data - the slot is ours until the request is posted */
     g_callback_manager.callback_data.This = This;
     g_callback_manager.callback_data.buffer_index = buffer_index;
     g_callback_manager.callback_data.direct_process = direct_process;
@@ -558,30 +813,96 @@ static void marshal_asio_callback(IWineASIOImpl *This, LONG buffer_index, ASIOBo
         g_callback_manager.callback_data.asio_time = *asio_time;
     }
     
-    g_callback_manager.callback_data.callback_pending = true;
-    
-    LeaveCriticalSection(&g_callback_manager.callback_lock);
-    
     /* Signal the Wine thread to process the callback */
-    SetEvent(g_callback_manager.callback_data.callback_event);
-    
-    /* Wait for callback completion with timeout to prevent deadlocks */
-    DWORD wait_result = WaitForSingleObject(g_callback_manager.callback_data.callback_completed, 100); /* 100ms timeout */
+    g_callback_manager.callback_data.posted_ns = posted = monotonic_time_ns();
+    ticket = pw_handoff_post(&g_callback_manager.handoff);
     
-    if (wait_result == WAIT_TIMEOUT) {
-        WARN("ASIO callback timed out after 100ms\n");
-        printf("ASIO callback timed out - this may indicate a threading issue\n");
-    } else if (wait_result == WAIT_OBJECT_0) {
+    /* Wait for the host no longer than the graph can wait for us */
+    done = !pw_handoff_wait_done_until(&g_callback_manager.handoff, ticket, This->cycle_deadline_ns);
+    if (!done) {
+        wait_ns = monotonic_time_ns() - posted;
+        /* The host is still running; what we waited is all we know */
+        count_host_callback(This, wait_ns);
+        This->stats_cycle.deadline_misses++;
+        post_host_message(This, PENDING_OVERLOAD);
+        /* The 1st, 2nd, 4th, 8th... miss, an overloaded host would flood the log */
+        This->deadline_misses++;
+        if (!(This->deadline_misses & (This->deadline_misses - 1)))
+            PWASIO_LOG_WARNING("Host missed the bufferSwitch deadline after %llu us (%u misses)\n",
+                               (unsigned long long)(wait_ns / 1000), This->deadline_misses);
+    } else {
         /* Callback completed successfully */
         /* Verbose debug disabled for cleaner output - only show first few for verification */
         static int success_count = 0;
+        wait_ns = monotonic_time_ns() - posted;
+        count_host_callback(This, g_callback_manager.callback_data.host_ns);
+        if (This->stats.segment)
+            pw_stats_record(This->stats.segment, PW_STATS_HIST_WAKEUP, g_callback_manager.callback_data.wakeup_ns);
         if (success_count < 3) {  /* Reduced from 10 to 3 for minimal output */
-            printf("ASIO callback marshalling successful #%d\n", ++success_count);
+            PWASIO_LOG_INFO("ASIO callback marshalling successful #%d\n", ++success_count);
         } else if (success_count == 3) {
-            printf("ASIO callback marshalling working - further success messages suppressed\n");
+            PWASIO_LOG_INFO("ASIO callback marshalling working - further success messages suppressed\n");
             success_count++;
         }
     }
+
+    if (This->stats.segment) {
+        This->stats_cycle.marshal_wait_ns += wait_ns;
+        if (wait_ns > This->stats_cycle.marshal_wait_max_ns)
+            This->stats_cycle.marshal_wait_max_ns = wait_ns;
+    }
+    return done;
+}
+
+/* A direct callback longer than this many periods counts as the host blocking */
+#define DIRECT_DISPATCH_BLOCKING_PERIODS   4
+/* This many consecutive callbacks over one period also trigger the fallback */
+#define DIRECT_DISPATCH_MAX_OVERRUNS       8
+
+static void disable_direct_dispatch(IWineASIOImpl *This, const char *reason) {
+    if (This->direct_dispatch_disabled)
+        return;
+    This->direct_dispatch_disabled = true;
+    PWASIO_LOG_WARNING("Direct ASIO dispatch disabled (%s), falling back to marshalled callbacks\n", reason);
+}
+
+/* Run the host's bufferSwitch either directly on the PipeWire data thread or,
+ * by default, marshalled to the dedicated Wine callback thread. Direct mode
+ * needs the data thread to be a Wine-created thread and drops back to the
+ * marshalled path for good once the host blocks or misbehaves. Returns false
+ * when the host missed the cycle deadline and its outputs are not ready. */
+static bool dispatch_asio_callback(IWineASIOImpl *This, LONG buffer_index, ASIOBool direct_process,
+                                   ASIOTime *asio_time, bool use_time_info) {
+    uint64_t start, elapsed, period;
+
+    if (!This->pwasio_direct_dispatch || This->direct_dispatch_disabled || !tls_wine_created_thread)
+        return marshal_asio_callback(This, buffer_index, direct_process, asio_time, use_time_info);
+
+    deliver_host_messages(This);
+    start = monotonic_time_ns();
+    tls_in_direct_callback = true;
+    if (use_time_info && asio_time) {
+        This->asio_callbacks->bufferSwitchTimeInfo(asio_time, buffer_index, direct_process);
+    } else {
+        This->asio_callbacks->bufferSwitch(buffer_index, direct_process);
+    }
+    tls_in_direct_callback = false;
+    elapsed = monotonic_time_ns() - start;
+    count_host_callback(This, elapsed);
+
+    /* A direct callback cannot be abandoned; late or not, its outputs are
+     * the best there is */
+    period = (uint64_t)This->asio_current_buffersize * 1000000000ULL / (uint64_t)This->asio_sample_rate;
+    if (unlikely(elapsed > period)) {
+        post_host_message(This, PENDING_OVERLOAD);
+        if (elapsed > DIRECT_DISPATCH_BLOCKING_PERIODS * period)
+            disable_direct_dispatch(This, "host blocked in bufferSwitch");
+        else if (++This->direct_dispatch_overruns >= DIRECT_DISPATCH_MAX_OVERRUNS)
+            disable_direct_dispatch(This, "host repeatedly overran the period");
+    } else {
+        This->direct_dispatch_overruns = 0;
+    }
+    return true;
 }
 
 static void pipewire_state_changed_callback(void *data, enum pw_filter_state from, enum pw_filter_state to, char const *error) {
@@ -593,142 +914,446 @@ static void pipewire_state_changed_callback(void *data, enum pw_filter_state fro
     } else {
         putchar('\n');
     }
+
+    /* Wake anyone blocked in user_pw_wait_for_filter_state() */
+    if (This->pw_helper)
+        user_pw_notify_filter_state(This->pw_helper);
 }
 
+/* User data of a filter port; the port handle points at it */
+struct channel_port {
+    /* The port's channel, NULL for an interleaved port */
+    IOChannel *chan;
+    bool is_input;
+    /* Samples per frame of an interleaved port, 0 for a mono one */
+    uint32_t n_channels;
+    /* The port's SPA_IO_Buffers area, NULL while it has none */
+    struct spa_io_buffers *io;
+};
+
 static void pipewire_io_changed_callback(void *data, void *port, uint32_t id, void *area, uint32_t size) {
     IWineASIOImpl *This = (IWineASIOImpl*)data;
+    struct channel_port *p = port;
 
     printf("io_changed: iface:%p IO changed on port %p: 0x%04x\n", This, port, id);
+
+    if (p && id == SPA_IO_Buffers)
+        __atomic_store_n(&p->io, area && size >= sizeof(struct spa_io_buffers) ? area : NULL, __ATOMIC_RELEASE);
+}
+
+static IOChannel *find_channel_by_port(IWineASIOImpl *This, void *port) {
+    for (int idx = 0; idx < This->wineasio_number_inputs + This->wineasio_number_outputs; ++idx) {
+        if (This->input_channel[idx].port == port)
+            return &This->input_channel[idx];
+    }
+    return NULL;
+}
+
+/* Guards the port latencies in IOChannel, written on the PipeWire main loop
+ * and read by GetLatencies(). The data thread never takes it. */
+static pthread_mutex_t latency_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Longest path latency of the active channels, in frames at the current
+ * graph quantum and rate. Called with latency_mutex held. */
+static LONG path_latency(IWineASIOImpl *This, IOChannel const *chans, int count) {
+    uint32_t quantum = __atomic_load_n(&This->graph_quantum, __ATOMIC_RELAXED);
+    uint32_t rate = __atomic_load_n(&This->graph_rate, __ATOMIC_RELAXED);
+    uint64_t frames, longest = 0;
+
+    if (!chans)
+        return 0;
+    if (!quantum)
+        quantum = This->asio_current_buffersize;
+    if (!rate)
+        rate = (uint32_t)This->asio_sample_rate;
+    for (int idx = 0; idx < count; ++idx) {
+        if (!chans[idx].active)
+            continue;
+        frames = (uint64_t)(chans[idx].latency.max_quantum * quantum) + chans[idx].latency.max_rate +
+                 chans[idx].latency.max_ns * rate / SPA_NSEC_PER_SEC;
+        if (frames > longest)
+            longest = frames;
+    }
+    return (LONG)longest;
+}
+
+/* End-to-end latencies: one ASIO buffer, plus the block adapter's head start
+ * on the way out, plus what PipeWire reports for the path to the devices,
+ * which covers the graph quantum and the devices' own buffering. */
+static void compute_latencies(IWineASIOImpl *This, LONG *input, LONG *output) {
+    pthread_mutex_lock(&latency_mutex);
+    *input = This->asio_current_buffersize + path_latency(This, This->input_channel, This->wineasio_number_inputs);
+    *output = This->asio_current_buffersize + __atomic_load_n(&This->cycle.adapter_latency, __ATOMIC_RELAXED) +
+              path_latency(This, This->output_channel, This->wineasio_number_outputs);
+    pthread_mutex_unlock(&latency_mutex);
+}
+
+/* What the driver adds between its input and output ports: the block
+ * adapter's head start. The host runs within the graph cycle, so the ASIO
+ * double buffer itself adds nothing. */
+static struct spa_process_latency_info process_latency(IWineASIOImpl *This) {
+    return SPA_PROCESS_LATENCY_INFO_INIT(.rate = __atomic_load_n(&This->graph_adapter_latency, __ATOMIC_RELAXED));
+}
+
+static struct spa_pod *build_process_latency(IWineASIOImpl *This, struct spa_pod_builder *builder) {
+    struct spa_process_latency_info info = process_latency(This);
+    return spa_process_latency_build(builder, SPA_PARAM_ProcessLatency, &info);
+}
+
+/* The clock the graph should run at: the host's, or the one it is being
+ * moved to, see reconfigure_clock() */
+static void graph_clock_target(IWineASIOImpl *This, uint32_t *quantum, uint32_t *rate) {
+    uint32_t next_quantum = __atomic_load_n(&This->next_buffersize, __ATOMIC_RELAXED);
+    uint32_t next_rate = __atomic_load_n(&This->next_sample_rate, __ATOMIC_RELAXED);
+
+    *quantum = next_quantum ? next_quantum : (uint32_t)This->asio_current_buffersize;
+    *rate = next_rate ? next_rate : (uint32_t)This->asio_sample_rate;
+}
+
+/* Take on the rate the graph moved to while the host had buffers. Only called
+ * while the data thread does not run the host, between Stop() and Start(). */
+static void apply_next_sample_rate(IWineASIOImpl *This) {
+    uint32_t rate = __atomic_exchange_n(&This->next_sample_rate, 0, __ATOMIC_RELAXED);
+
+    if (!rate || rate == (uint32_t)This->asio_sample_rate)
+        return;
+    printf("Sample rate follows the graph: %u Hz\n", rate);
+    This->asio_sample_rate = rate;
+}
+
+/* Format, process latency and buffer params of the filter, for
+ * pw_filter_connect() and pw_filter_update_params(). Returns how many were
+ * built into `params`. */
+static uint32_t build_filter_params(IWineASIOImpl *This, struct spa_pod_builder *builder,
+                                    struct spa_pod const *params[3]) {
+    uint32_t quantum, rate;
+    struct spa_audio_info_raw format;
+
+    graph_clock_target(This, &quantum, &rate);
+    format = SPA_AUDIO_INFO_RAW_INIT(
+        .format = SPA_AUDIO_FORMAT_F32,
+        .rate = rate,
+        .channels = This->asio_active_outputs,
+    );
+    params[0] = spa_format_audio_raw_build(builder, SPA_PARAM_EnumFormat, &format);
+    params[1] = build_process_latency(This, builder);
+    /* Timing constraints to ensure consistent buffer sizes */
+    params[2] = spa_pod_builder_add_object(builder,
+        SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+        SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
+        SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
+        SPA_PARAM_BUFFERS_size, SPA_POD_Int(quantum * sizeof(float)),
+        SPA_PARAM_BUFFERS_stride, SPA_POD_Int(sizeof(float)));
+    return 3;
+}
+
+/* Widen `range` to cover one port's latency; `first` starts a new range */
+static void combine_latency(struct spa_latency_info *range, struct pw_cycle_latency const *port, bool first) {
+    if (first || port->min_quantum < range->min_quantum) range->min_quantum = port->min_quantum;
+    if (first || port->min_rate < range->min_rate) range->min_rate = port->min_rate;
+    if (first || port->min_ns < range->min_ns) range->min_ns = port->min_ns;
+    if (port->max_quantum > range->max_quantum) range->max_quantum = port->max_quantum;
+    if (port->max_rate > range->max_rate) range->max_rate = port->max_rate;
+    if (port->max_ns > range->max_ns) range->max_ns = port->max_ns;
+}
+
+static void add_process_latency(struct spa_latency_info *info, struct spa_process_latency_info const *process) {
+    info->min_quantum += process->quantum;
+    info->max_quantum += process->quantum;
+    info->min_rate += process->rate;
+    info->max_rate += process->rate;
+    info->min_ns += process->ns;
+    info->max_ns += process->ns;
+}
+
+/* Publish SPA_PARAM_Latency on our ports, as a node with
+ * PW_FILTER_FLAG_CUSTOM_LATENCY has to: the capture latency arriving at the
+ * inputs is passed on to the outputs, and the playback latency seen by the
+ * outputs is passed back to the inputs, each plus our own process latency.
+ * Other clients in the graph compensate with these. Runs on the PipeWire main
+ * loop, or with it locked. */
+static void publish_port_latencies(IWineASIOImpl *This) {
+    struct spa_latency_info capture = SPA_LATENCY_INFO(SPA_DIRECTION_OUTPUT);
+    struct spa_latency_info playback = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT);
+    struct spa_process_latency_info process = process_latency(This);
+    uint8_t pod_buffer[1024];
+    struct spa_pod_builder pod_builder;
+    struct spa_pod const *param;
+    bool capture_changed, playback_changed;
+    int idx;
+
+    if (!This->pw_filter || !This->input_channel)
+        return;
+
+    pthread_mutex_lock(&latency_mutex);
+    for (idx = 0; idx < This->wineasio_number_inputs; ++idx)
+        combine_latency(&capture, &This->input_channel[idx].latency, idx == 0);
+    for (idx = 0; idx < This->wineasio_number_outputs; ++idx)
+        combine_latency(&playback, &This->output_channel[idx].latency, idx == 0);
+    add_process_latency(&capture, &process);
+    add_process_latency(&playback, &process);
+    capture_changed = memcmp(&capture, &This->published_capture, sizeof capture) != 0;
+    playback_changed = memcmp(&playback, &This->published_playback, sizeof playback) != 0;
+    This->published_capture = capture;
+    This->published_playback = playback;
+    pthread_mutex_unlock(&latency_mutex);
+
+    if (capture_changed) {
+        pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
+        param = spa_latency_build(&pod_builder, SPA_PARAM_Latency, &capture);
+        for (idx = 0; idx < This->wineasio_number_outputs; ++idx) {
+            if (This->output_channel[idx].port)
+                pw_filter_update_params(This->pw_filter, This->output_channel[idx].port, &param, 1);
+        }
+        if (This->cycle.interleaved_outputs)
+            pw_filter_update_params(This->pw_filter, This->cycle.interleaved_outputs, &param, 1);
+    }
+    if (playback_changed) {
+        pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
+        param = spa_latency_build(&pod_builder, SPA_PARAM_Latency, &playback);
+        for (idx = 0; idx < This->wineasio_number_inputs; ++idx) {
+            if (This->input_channel[idx].port)
+                pw_filter_update_params(This->pw_filter, This->input_channel[idx].port, &param, 1);
+        }
+        if (This->cycle.interleaved_inputs)
+            pw_filter_update_params(This->pw_filter, This->cycle.interleaved_inputs, &param, 1);
+    }
+}
+
+/* pw_loop_invoke() target: the adapter head start changed on the data thread */
+static int invoke_publish_latencies(struct spa_loop *loop, bool async, uint32_t seq,
+                                    const void *data, size_t size, void *user_data) {
+    IWineASIOImpl *This = (IWineASIOImpl*)user_data;
+    struct spa_process_latency_info info = process_latency(This);
+    uint8_t pod_buffer[256];
+    struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
+    struct spa_pod const *param;
+
+    if (!This->pw_filter)
+        return 0;
+    param = spa_process_latency_build(&pod_builder, SPA_PARAM_ProcessLatency, &info);
+    pw_filter_update_params(This->pw_filter, NULL, &param, 1);
+    publish_port_latencies(This);
+    return 0;
+}
+
+/* Ask the graph for the host's buffer size and sample rate, or withdraw the
+ * request. node.latency and node.rate are requests that PipeWire weighs
+ * against the other clients'; node.force-quantum and node.force-rate win over
+ * them. They are node properties, so they also go away with the node when the
+ * host exits without DisposeBuffers. Runs with the PipeWire loop locked. */
+static void request_graph_clock(IWineASIOImpl *This, bool request) {
+    char latency[32], rate[32], force_quantum[16], force_rate[16];
+    bool force = request && This->pwasio_force_graph_clock;
+    struct spa_dict_item items[4];
+    struct spa_dict dict;
+    uint32_t target_quantum, target_rate;
+
+    if (!This->pw_filter || (!request && !This->graph_clock_requested))
+        return;
+
+    graph_clock_target(This, &target_quantum, &target_rate);
+    snprintf(latency, sizeof latency, "%u/%u", target_quantum, target_rate);
+    snprintf(rate, sizeof rate, "1/%u", target_rate);
+    snprintf(force_quantum, sizeof force_quantum, "%u", target_quantum);
+    snprintf(force_rate, sizeof force_rate, "%u", target_rate);
+
+    /* A NULL value removes the property */
+    items[0] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LATENCY, request ? latency : NULL);
+    items[1] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_RATE, request ? rate : NULL);
+    items[2] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_FORCE_QUANTUM, force ? force_quantum : NULL);
+    items[3] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_FORCE_RATE, force ? force_rate : NULL);
+    dict = SPA_DICT_INIT(items, ARRAYSIZE(items));
+
+    if (pw_filter_update_properties(This->pw_filter, NULL, &dict) < 0) {
+        WARN("Failed to update the graph clock request\n");
+        return;
+    }
+    This->graph_clock_requested = request;
+    if (request)
+        printf("Requested graph quantum %s at %s Hz%s\n", force_quantum, force_rate, force ? " (forced)" : "");
+    else
+        TRACE("Released the graph clock request\n");
+}
+
+/* Move the connected filter to graph_clock_target() in place: new node
+ * properties for the graph, new params for the filter. PipeWire applies them
+ * at its next cycle boundaries, without the disconnect/reconnect round trip
+ * and the silence that comes with it. */
+static void apply_graph_clock(IWineASIOImpl *This) {
+    uint8_t pod_buffer[0x1000];
+    struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
+    struct spa_pod const *params[3];
+    uint32_t n_params;
+
+    if (!This->pw_filter)
+        return;
+    user_pw_lock_loop(This->pw_helper);
+    if (pw_filter_get_state(This->pw_filter, NULL) != PW_FILTER_STATE_UNCONNECTED) {
+        n_params = build_filter_params(This, &pod_builder, params);
+        if (pw_filter_update_params(This->pw_filter, NULL, params, n_params) < 0)
+            WARN("Failed to update the filter params\n");
+        request_graph_clock(This, true);
+    }
+    user_pw_unlock_loop(This->pw_helper);
+}
+
+/* The reconfiguration engine for a new buffer size and/or sample rate, 0 to
+ * keep the current one. Before CreateBuffers() they are simply what the next
+ * buffers are made with. Once the host has buffers, only the host can
+ * replace them: the graph is moved in place (apply_graph_clock()), the block
+ * adapter bridges the new quantum meanwhile, and the host is asked to
+ * re-create its buffers with kAsioBufferSizeChange, or to reset (see
+ * deliver_graph_clock()). The arena for them is then allocated by
+ * CreateBuffers(), outside the data thread, and the data thread switches
+ * over at the Stop()/Start() around it. */
+static void reconfigure_clock(IWineASIOImpl *This, LONG buffersize, double rate) {
+    if (This->asio_driver_state < Prepared) {
+        if (buffersize)
+            This->asio_current_buffersize = buffersize;
+        if (rate)
+            This->asio_sample_rate = rate;
+        return;
+    }
+
+    if (buffersize && buffersize != This->asio_current_buffersize) {
+        __atomic_store_n(&This->next_buffersize, (uint32_t)buffersize, __ATOMIC_RELAXED);
+        post_host_message(This, PENDING_BUFFER_SIZE);
+    }
+    if (rate && rate != This->asio_sample_rate) {
+        __atomic_store_n(&This->next_sample_rate, (uint32_t)rate, __ATOMIC_RELAXED);
+        post_host_message(This, PENDING_SAMPLE_RATE);
+    }
+    apply_graph_clock(This);
 }
 
 static void pipewire_param_changed_callback(void *data, void *port, uint32_t id, struct spa_pod const *param) {
     IWineASIOImpl *This = (IWineASIOImpl*)data;
+    struct channel_port *p = port;
+    struct spa_latency_info info = { 0 };
+    IOChannel *chans;
+    int count, idx;
+    LONG input, output;
 
     printf("param_changed: iface:%p param 0x%04x changed on port %p\n", This, id, port);
+
+    if (id != SPA_PARAM_Latency || !p || !This->input_channel)
+        return;
+
+    /* Inputs care about the capture latency upstream of them, outputs about
+     * the playback latency downstream */
+    if (param && (spa_latency_parse(param, &info) < 0 ||
+                  info.direction != (p->is_input ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT)))
+        return;
+
+    /* An interleaved port's latency is that of all its channels */
+    if (p->chan) {
+        chans = p->chan;
+        count = 1;
+    } else {
+        chans = p->is_input ? This->input_channel : This->output_channel;
+        count = p->is_input ? This->wineasio_number_inputs : This->wineasio_number_outputs;
+    }
+    pthread_mutex_lock(&latency_mutex);
+    for (idx = 0; idx < count; ++idx) {
+        chans[idx].latency.min_quantum = info.min_quantum;
+        chans[idx].latency.max_quantum = info.max_quantum;
+        chans[idx].latency.min_rate = info.min_rate;
+        chans[idx].latency.max_rate = info.max_rate;
+        chans[idx].latency.min_ns = info.min_ns;
+        chans[idx].latency.max_ns = info.max_ns;
+    }
+    pthread_mutex_unlock(&latency_mutex);
+    publish_port_latencies(This);
+
+    compute_latencies(This, &input, &output);
+    if (input != This->reported_input_latency || output != This->reported_output_latency) {
+        TRACE("Port %s latency changed, input %d output %d frames\n",
+              p->chan ? p->chan->port_name : p->is_input ? INTERLEAVED_INPUT_PORT : INTERLEAVED_OUTPUT_PORT, input, output);
+        post_host_message(This, PENDING_LATENCIES);
+    }
+}
+
+/* Whether the host can work directly in the two mapped port buffers of `chan` */
+static bool zero_copy_usable(IOChannel *chan, size_t bytes) {
+    for (int idx = 0; idx < 2; ++idx) {
+        struct spa_data *d;
+
+        if (!chan->buffers[idx] || !chan->buffers[idx]->buffer || chan->buffers[idx]->buffer->n_datas < 1)
+            return false;
+        d = &chan->buffers[idx]->buffer->datas[0];
+        if (!d->data || d->maxsize < bytes || !SPA_IS_ALIGNED(d->data, 16))
+            return false;
+    }
+    return true;
 }
 
 static void pipewire_add_buffer_callback(void *data, void *port, struct pw_buffer *buffer) {
     IWineASIOImpl *This = (IWineASIOImpl*)data;
+    IOChannel     *chan = find_channel_by_port(This, port);
 
     printf("add_buffer: iface:%p port:%p, buffer:%p\n", This, port, buffer);
 
-    for (int idx = 0; idx < This->wineasio_number_inputs + This->wineasio_number_outputs; ++idx) {
-        IOChannel *chan = &This->input_channel[idx];
-        if (chan->port == port) {
-            if (chan->buffers[1]) {
-                if (chan->buffers[0]) {
-                    printf("Buffers for channel %s already full!\n", chan->port_name);
-                    return;
-                } else {
-                    printf("Adding second buffer for channel %s\n", chan->port_name);
-                    chan->buffers[0] = buffer;
-
-                    buffer = pw_filter_dequeue_buffer(chan->port);
-                    buffer->buffer->datas[0].chunk->offset = 0;
-                    buffer->buffer->datas[0].chunk->stride = sizeof(float);
-                    buffer->buffer->datas[0].chunk->size = 0;
-                    printf("Dequeued buffer: %p\n", buffer);
-                }
-            } else {
-                printf("Adding first buffer for channel %s\n", chan->port_name);
-                chan->buffers[1] = buffer;
-            }
+    if (!chan)
+        return;
+    if (!chan->buffers[0]) {
+        chan->buffers[0] = buffer;
+    } else if (!chan->buffers[1]) {
+        chan->buffers[1] = buffer;
+    } else {
+        printf("Buffers for channel %s already full!\n", chan->port_name);
+    }
 
-            This->asio_buffers_left_to_init -= 1;
-            if (This->asio_buffers_left_to_init == 0) {
-                // Signal the creator thread
-                pthread_barrier_wait(&This->asio_buffers_filled);
-            }
-            break;
-        }
+    /* Ports added by CreateBuffers() only get their buffers once they are
+     * linked, after the host already has copying buffers. Ask it to
+     * re-create them; the next CreateBuffers() keeps the port and maps them. */
+    if (chan >= This->output_channel && chan->active && chan->needs_copy &&
+        __atomic_load_n(&This->zero_copy_waiting, __ATOMIC_RELAXED) &&
+        zero_copy_usable(chan, chan->buffer_size)) {
+        TRACE("Port buffers of channel %s mapped, requesting ASIO reset for zero-copy\n", chan->port_name);
+        __atomic_store_n(&This->zero_copy_waiting, false, __ATOMIC_RELAXED);
+        post_host_message(This, PENDING_RESET);
     }
 }
 
 static void pipewire_remove_buffer_callback(void *data, void *port, struct pw_buffer *buffer) {
     IWineASIOImpl *This = (IWineASIOImpl*)data;
+    IOChannel     *chan = find_channel_by_port(This, port);
 
     printf("remove_buffer: iface:%p port:%p, buffer:%p\n", This, port, buffer);
-}
 
-static void pipewire_process_callback(void *data, struct spa_io_position *position) {
-    IWineASIOImpl *This = (IWineASIOImpl*)data;
-    int            idx;
-    size_t         pw_sample_count = position->clock.duration;
-    size_t         asio_sample_count = This->asio_current_buffersize;
-    size_t         process_samples = asio_sample_count; /* Always use fixed ASIO buffer size */
-    
-    /* Fast validation - minimize branches in real-time path */
-    if (unlikely(!This || This->asio_driver_state != Running || !This->asio_callbacks)) {
-        /* Output silence if not ready - optimized for minimal CPU usage */
-        if (This && This->output_channel) {
-            for (idx = 0; idx < This->asio_active_outputs; ++idx) {
-                if (This->output_channel[idx].port) {
-                    void *buffer = pw_filter_get_dsp_buffer(This->output_channel[idx].port, pw_sample_count);
-                    if (buffer) {
-                        /* Use optimized zero-fill for silence */
-                        __builtin_memset(buffer, 0, pw_sample_count * sizeof(float));
-                    }
-                }
-            }
-        }
+    if (!chan)
         return;
+    for (int idx = 0; idx < 2; ++idx) {
+        if (chan->buffers[idx] == buffer)
+            chan->buffers[idx] = NULL;
     }
 
-    /* Handle variable PipeWire buffer sizes - optimized path */
-    if (unlikely(pw_sample_count != asio_sample_count)) {
-        /* Use the smaller of the two to prevent buffer overruns */
-        process_samples = (pw_sample_count < asio_sample_count) ? pw_sample_count : asio_sample_count;
+    /* The host still holds pointers into this buffer. Stop calling it (the
+     * process callback outputs silence) and ask it to re-create its buffers,
+     * from the callback thread: this runs on the PipeWire thread with the
+     * loop locked, where a host disposing its buffers would deadlock. */
+    if (!chan->needs_copy && !This->zero_copy_lost) {
+        WARN("Port buffers of zero-copy channel %s removed, requesting ASIO reset\n", chan->port_name);
+        __atomic_store_n(&This->zero_copy_lost, true, __ATOMIC_RELAXED);
+        post_host_message(This, PENDING_RESET);
     }
+}
 
-    /* Pre-calculate common values to avoid repeated calculations */
-    size_t asio_buffer_bytes;
-    size_t process_bytes;
-    LONG input_buffer_index;
-    LONG current_buffer_index;
-    
-    asio_buffer_bytes = asio_sample_count * sizeof(float);
-    process_bytes = process_samples * sizeof(float);
-    input_buffer_index = This->asio_buffer_index;
-    
-    /* Optimized input processing - minimize memory operations */
-    for (idx = 0; idx < This->asio_active_inputs; ++idx) {
-        IOChannel *chan = &This->input_channel[idx];
-        if (likely(chan->active && chan->port && chan->wine_buffers[input_buffer_index])) {
-            void *pw_buffer = pw_filter_get_dsp_buffer(chan->port, pw_sample_count);
-            
-            if (likely(pw_buffer && chan->buffer_size >= asio_buffer_bytes)) {
-                if (likely(process_samples == asio_sample_count)) {
-                    /* Fast path: direct copy with compiler optimization hints */
-                    __builtin_memcpy(chan->wine_buffers[input_buffer_index], pw_buffer, asio_buffer_bytes);
-                } else {
-                    /* Slower path: copy + zero-pad */
-                    __builtin_memcpy(chan->wine_buffers[input_buffer_index], pw_buffer, process_bytes);
-                    
-                    /* Zero-pad remaining space efficiently */
-                    if (process_bytes < asio_buffer_bytes) {
-                        __builtin_memset((char*)chan->wine_buffers[input_buffer_index] + process_bytes, 0, 
-                                       asio_buffer_bytes - process_bytes);
-                    }
-                }
-            }
-        }
-    }
+/* Advance the ASIO clock by one buffer that started at `block_time_ns` and run
+ * the host's bufferSwitch on `buffer_index` */
+static inline bool run_buffer_switch(IWineASIOImpl *This, LONG buffer_index, uint64_t block_time_ns, bool freewheel) {
+    This->asio_sample_position += This->asio_current_buffersize;
 
-    /* Update timing information - optimized for minimal overhead */
-    This->asio_sample_position += asio_sample_count;
-    
     /* Optimized timestamp calculation */
-    if (likely(!(position->clock.flags & SPA_IO_CLOCK_FLAG_FREEWHEEL))) {
+    if (likely(!freewheel)) {
         /* Use PipeWire's clock time - fastest path */
-        This->asio_time_stamp = position->clock.nsec / 1000ULL;
+        This->asio_time_stamp = block_time_ns / 1000ULL;
     } else {
         /* Freewheel mode - calculate from sample position */
         This->asio_time_stamp = (uint64_t)((double)This->asio_sample_position * 1000000.0 / This->asio_sample_rate);
     }
 
-    /* Marshal ASIO callback - capture buffer index before it changes */
-    current_buffer_index = This->asio_buffer_index;
-    
     /* Optimized callback marshalling */
     if (likely(This->asio_time_info_mode)) {
         /* Pre-fill time structure for efficiency */
@@ -736,40 +1361,175 @@ static void pipewire_process_callback(void *data, struct spa_io_position *positi
         This->asio_time.timeInfo.systemTime = ASIO_LONG(ASIOTimeStamp, This->asio_time_stamp);
         This->asio_time.timeInfo.sampleRate = This->asio_sample_rate;
         This->asio_time.timeInfo.flags = kSystemTimeValid | kSamplePositionValid | kSampleRateValid;
-        marshal_asio_callback(This, current_buffer_index, ASIOTrue, &This->asio_time, true);
+        return dispatch_asio_callback(This, buffer_index, ASIOTrue, &This->asio_time, true);
+    }
+    return dispatch_asio_callback(This, buffer_index, ASIOTrue, NULL, false);
+}
+
+/* pw_filter_get_dsp_buffer() for an interleaved port, whose frames are
+ * n_channels samples wide. NULL when the buffer cannot hold `n_samples`
+ * frames. */
+static void *get_interleaved_buffer(struct channel_port *p, uint32_t n_samples) {
+    uint32_t bytes = n_samples * p->n_channels * sizeof(float);
+    struct pw_buffer *buffer = pw_filter_dequeue_buffer(p);
+    struct spa_data *d;
+    uint32_t offset;
+
+    if (unlikely(!buffer))
+        return NULL;
+    d = &buffer->buffer->datas[0];
+    if (!p->is_input) {
+        d->chunk->offset = 0;
+        d->chunk->size = bytes;
+        d->chunk->stride = p->n_channels * sizeof(float);
+        d->chunk->flags = 0;
+    }
+    offset = SPA_MIN(d->chunk->offset, d->maxsize);
+    pw_filter_queue_buffer(p, buffer);
+    if (unlikely(!d->data || d->maxsize - offset < bytes))
+        return NULL;
+    return SPA_PTROFF(d->data, offset, void);
+}
+
+/* The filter republishes every port's io area from its own buffer queues
+ * around the process callback, so the buffers still go through them. The
+ * io area and the buffer ids mapped by add_buffer only decide whether there
+ * is anything to dequeue: a port without io is not in the graph cycle, and
+ * an input whose io holds no mapped buffer got nothing from its peers. */
+static void *cycle_get_buffer(void *data, void *port, uint32_t n_samples) {
+    struct channel_port *p = port;
+    struct spa_io_buffers *io = __atomic_load_n(&p->io, __ATOMIC_ACQUIRE);
+
+    if (unlikely(!io))
+        return NULL;
+    if (p->n_channels)
+        return get_interleaved_buffer(p, n_samples);
+    if (p->is_input && (io->buffer_id >= ARRAYSIZE(p->chan->buffers) || !p->chan->buffers[io->buffer_id]))
+        return NULL;
+    return pw_filter_get_dsp_buffer(port, n_samples);
+}
+
+static bool cycle_buffer_switch(void *data, int buffer_index, uint64_t time_ns, bool freewheel) {
+    return run_buffer_switch((IWineASIOImpl*)data, buffer_index, time_ns, freewheel);
+}
+
+/* The host was still busy with a late buffer when this one was due. It still
+ * counts on the ASIO clock so that the next bufferSwitch reports the position
+ * and time the graph is at. */
+static void cycle_buffer_skipped(void *data, uint64_t time_ns) {
+    IWineASIOImpl *This = (IWineASIOImpl*)data;
+
+    This->asio_sample_position += This->asio_current_buffersize;
+    This->stats_cycle.skipped_buffers++;
+}
+
+static const struct pw_cycle_ops cycle_ops = {
+    .get_buffer = cycle_get_buffer,
+    .buffer_switch = cycle_buffer_switch,
+    .buffer_skipped = cycle_buffer_skipped,
+};
+
+/* Close the current cycle's statistics and publish them for pipewine-stat.
+ * `start` is when the process callback was entered. */
+static void publish_cycle_stats(IWineASIOImpl *This, struct spa_io_position const *position, uint64_t start) {
+    struct pw_stats_cycle *stats = &This->stats_cycle;
+    uint64_t interval, period;
+
+    stats->process_ns = monotonic_time_ns() - start;
+    pw_stats_record(This->stats.segment, PW_STATS_HIST_CYCLE, stats->process_ns);
+
+    /* How far the wakeups drift from the period the graph asked for */
+    if (This->stats_last_start && position->clock.rate.denom) {
+        interval = start - This->stats_last_start;
+        period = (uint64_t)position->clock.duration * position->clock.rate.num * 1000000000ULL / position->clock.rate.denom;
+        pw_stats_record(This->stats.segment, PW_STATS_HIST_JITTER, interval > period ? interval - period : period - interval);
+    }
+    This->stats_last_start = start;
+
+    stats->clock_nsec = position->clock.nsec;
+    stats->quantum = position->clock.duration;
+    stats->rate = position->clock.rate.denom;
+    stats->rate_diff = position->clock.rate_diff;
+
+    pw_stats_publish(This->stats.segment, stats);
+    memset(stats, 0, sizeof *stats);
+}
+
+/* Follow the graph position. A gap means the graph skipped cycles (an xrun):
+ * the ASIO sample position moves on by the frames that passed so that the
+ * host's timeline stays in step with the graph. When the position went back
+ * or jumped by more than a second there is no timeline to keep, and the host
+ * is asked to resync instead. */
+static void track_graph_position(IWineASIOImpl *This, struct spa_io_position const *position) {
+    uint64_t expected = This->cycle_next_position;
+    uint64_t actual = position->clock.position;
+
+    This->cycle_next_position = actual + position->clock.duration;
+    if (likely(!expected || actual == expected))
+        return;
+
+    This->stats_cycle.xrun = true;
+    if (actual > expected && actual - expected <= (uint64_t)This->asio_sample_rate)
+        This->asio_sample_position += actual - expected;
+    else
+        post_host_message(This, PENDING_RESYNC);
+}
+
+static void pipewire_process_callback(void *data, struct spa_io_position *position) {
+    IWineASIOImpl *This = (IWineASIOImpl*)data;
+    struct pw_cycle_plan const *plan;
+    uint32_t quantum;
+    uint64_t start, period;
+    bool freewheel;
+
+    /* Fast validation - minimize branches in real-time path */
+    if (unlikely(!This || This->asio_driver_state != Running || !This->asio_callbacks || This->zero_copy_lost)) {
+        if (This)
+            pw_cycle_silence(&This->cycle, position->clock.duration);
+        return;
+    }
+
+    start = monotonic_time_ns();
+    quantum = position->clock.duration;
+    freewheel = position->clock.flags & SPA_IO_CLOCK_FLAG_FREEWHEEL;
+    track_graph_position(This, position);
+
+    /* The host has to be done while the graph can still use its outputs.
+     * Zero-copy outputs are the port buffers themselves and cannot be
+     * replaced by the late policy's data, so with any in the plan the graph
+     * waits for the host as in freewheel. */
+    plan = __atomic_load_n(&This->cycle.plan, __ATOMIC_ACQUIRE);
+    if (likely(!freewheel && position->clock.rate.denom && !(plan && plan->n_mapped))) {
+        period = (uint64_t)quantum * position->clock.rate.num * 1000000000ULL / position->clock.rate.denom;
+        This->cycle_deadline_ns = start + period * CALLBACK_DEADLINE_PERCENT / 100;
     } else {
-        marshal_asio_callback(This, current_buffer_index, ASIOTrue, NULL, false);
+        This->cycle_deadline_ns = start + FREEWHEEL_DEADLINE_NS;
     }
 
-    /* Optimized output processing - minimize memory operations */
-    for (idx = 0; idx < This->asio_active_outputs; ++idx) {
-        IOChannel *chan = &This->output_channel[idx];
-        if (likely(chan->active && chan->port && chan->wine_buffers[current_buffer_index])) {
-            void *pw_buffer = pw_filter_get_dsp_buffer(chan->port, pw_sample_count);
-            
-            if (likely(pw_buffer && chan->buffer_size >= asio_buffer_bytes)) {
-                if (likely(pw_sample_count == asio_sample_count)) {
-                    /* Fast path: direct copy */
-                    __builtin_memcpy(pw_buffer, chan->wine_buffers[current_buffer_index], asio_buffer_bytes);
-                } else {
-                    /* Handle size mismatch efficiently */
-                    const size_t pw_buffer_bytes = pw_sample_count * sizeof(float);
-                    const size_t copy_bytes = (pw_sample_count < asio_sample_count) ? 
-                                            pw_buffer_bytes : asio_buffer_bytes;
-                    
-                    __builtin_memcpy(pw_buffer, chan->wine_buffers[current_buffer_index], copy_bytes);
-                    
-                    /* Zero-pad remaining PipeWire buffer space if needed */
-                    if (copy_bytes < pw_buffer_bytes) {
-                        __builtin_memset((char*)pw_buffer + copy_bytes, 0, pw_buffer_bytes - copy_bytes);
-                    }
-                }
-            }
+    /* A host that missed an earlier deadline still holds its buffer half */
+    if (unlikely(!pw_handoff_idle(&g_callback_manager.handoff)))
+        pw_cycle_skip(&This->cycle, quantum, position->clock.nsec);
+    else
+        pw_cycle_process(&This->cycle, quantum, position->clock.nsec, freewheel);
+
+    /* The latencies in frames follow the quantum and the adapter head start */
+    if (unlikely(quantum != This->graph_quantum || position->clock.rate.denom != This->graph_rate ||
+                 This->cycle.adapter_latency != This->graph_adapter_latency)) {
+        if (This->graph_quantum) {
+            post_host_message(This, PENDING_LATENCIES);
+            follow_graph_clock(This, quantum != This->graph_quantum ? quantum : 0,
+                               position->clock.rate.denom != This->graph_rate ? position->clock.rate.denom : 0);
+        }
+        __atomic_store_n(&This->graph_quantum, quantum, __ATOMIC_RELAXED);
+        __atomic_store_n(&This->graph_rate, position->clock.rate.denom, __ATOMIC_RELAXED);
+        if (This->cycle.adapter_latency != This->graph_adapter_latency) {
+            __atomic_store_n(&This->graph_adapter_latency, This->cycle.adapter_latency, __ATOMIC_RELAXED);
+            /* The graph learns about it from the main loop */
+            pw_loop_invoke(This->pw_loop, invoke_publish_latencies, 0, NULL, 0, false, This);
         }
     }
-
-    /* Atomic buffer index switch for thread safety */
-    This->asio_buffer_index ^= 1;
+    if (This->stats.segment)
+        publish_cycle_stats(This, position, start);
 }
 
 /* Worker callback function to handle deferred PipeWire operations */
@@ -799,13 +1559,9 @@ static int pipewire_worker_callback(void *userdata, enum pw_op_type operation) {
                 .channels = This->asio_active_outputs,
             );
             
-            /* Calculate latency in nanoseconds from buffer size and sample rate */
-            uint64_t latency_ns = (uint64_t)This->asio_current_buffersize * SPA_NSEC_PER_SEC / (uint64_t)This->asio_sample_rate;
-            
             struct spa_pod const *connect_params[] = {
                 spa_format_audio_raw_build(&pod_builder, SPA_PARAM_EnumFormat, &format),
-                spa_process_latency_build(&pod_builder, SPA_PARAM_ProcessLatency,
-                    &SPA_PROCESS_LATENCY_INFO_INIT(.ns = latency_ns)),
+                build_process_latency(This, &pod_builder),
             };
             
             TRACE("Worker: Connecting PipeWire filter in correct thread context\n");
@@ -816,7 +1572,7 @@ static int pipewire_worker_callback(void *userdata, enum pw_op_type operation) {
             /* Verbose debug disabled for cleaner output */
             /* printf("Worker: Connecting PipeWire filter with rate=%f, channels=%d\n", This->asio_sample_rate, This->asio_active_outputs); */
             
-            if (pw_filter_connect(This->pw_filter, PW_FILTER_FLAG_RT_PROCESS, connect_params, ARRAYSIZE(connect_params)) < 0) {
+            if (pw_filter_connect(This->pw_filter, PW_FILTER_FLAG_RT_PROCESS | PW_FILTER_FLAG_CUSTOM_LATENCY, connect_params, ARRAYSIZE(connect_params)) < 0) {
                 ERR("Worker: Failed to connect PipeWire filter\n");
                 printf("Worker: Failed to connect PipeWire filter\n");
                 result = -1;
@@ -907,31 +1663,41 @@ HIDDEN ULONG STDMETHODCALLTYPE Release(LPWINEASIO iface)
     if (This->asio_driver_state == Prepared)
         DisposeBuffers(iface);
 
-    if (This->asio_driver_state == Initialized)
-    {
-        /* just for good measure we deinitialize IOChannel structures and unregister JACK ports */
-        for (int i = 0; i < This->wineasio_number_inputs; i++)
-        {
-            //jack_port_unregister (This->jack_client, This->input_channel[i].port);
-            This->input_channel[i].active = false;
-        }
-        for (int i = 0; i < This->wineasio_number_outputs; i++)
-        {
-            //jack_port_unregister (This->jack_client, This->output_channel[i].port);
-            This->output_channel[i].active = false;
-        }
-        This->asio_active_inputs = This->asio_active_outputs = 0;
-        TRACE("%i IOChannel structures released\n", This->wineasio_number_inputs + This->wineasio_number_outputs);
-
-        //jack_free (This->jack_output_ports);
-        //jack_free (This->jack_input_ports);
-        //jack_client_close(This->jack_client);
-        if (This->input_channel)
-            HeapFree(GetProcessHeap(), 0, This->input_channel);
-    }
     if (ref == 0) {
         /* Cleanup ASIO callback manager on final release */
         cleanup_asio_callback_manager();
+
+        /* The connection outlives us, so the filter must not */
+        if (This->pw_filter) {
+            user_pw_lock_loop(This->pw_helper);
+            pw_filter_destroy(This->pw_filter);
+            This->pw_filter = NULL;
+            This->cycle.interleaved_inputs = This->cycle.interleaved_outputs = NULL;
+            user_pw_unlock_loop(This->pw_helper);
+            /* Let latency updates the data thread queued on the loop run
+             * before we are freed */
+            pw_loop_invoke(This->pw_loop, NULL, 0, NULL, 0, true, NULL);
+        }
+
+        /* The filter and its callbacks were the last users of the channels.
+         * Earlier releases keep them: the filter stays connected after
+         * DisposeBuffers and its process callback still walks them. */
+        if (This->input_channel) {
+            HeapFree(GetProcessHeap(), 0, This->input_channel);
+            This->input_channel = This->output_channel = NULL;
+            This->cycle.inputs = This->cycle.outputs = NULL;
+            This->cycle.routes = NULL;
+            This->cycle.input_planes = NULL;
+            This->cycle.output_planes = NULL;
+            This->asio_active_inputs = This->asio_active_outputs = 0;
+            TRACE("%i IOChannel structures released\n", This->wineasio_number_inputs + This->wineasio_number_outputs);
+        }
+        if (This->pw_helper) {
+            user_pw_remove_settings_listener(This->pw_helper, graph_settings_changed, This);
+            user_pw_release_helper(This->pw_helper);
+            This->pw_helper = NULL;
+        }
+        pw_stats_destroy(&This->stats);
         
         TRACE("PipeWine terminated\n\n");
         This->cls_factory->lpVtbl->Release(This->cls_factory);
@@ -953,13 +1719,13 @@ static void clear_audio_buffers(IWineASIOImpl *This, const char *context) {
     /* Clear input channel buffers */
     for (int i = 0; i < This->wineasio_number_inputs; i++) {
         if (This->input_channel[i].active) {
-            /* Clear Wine-allocated buffers with bounds checking */
-            if (This->input_channel[i].wine_buffers[0] && This->input_channel[i].buffer_size > 0) {
-                memset(This->input_channel[i].wine_buffers[0], 0, This->input_channel[i].buffer_size);
+            /* Clear the host buffers with bounds checking */
+            if (This->input_channel[i].host_buffers[0] && This->input_channel[i].buffer_size > 0) {
+                memset(This->input_channel[i].host_buffers[0], 0, This->input_channel[i].buffer_size);
                 cleared_buffers++;
             }
-            if (This->input_channel[i].wine_buffers[1] && This->input_channel[i].buffer_size > 0) {
-                memset(This->input_channel[i].wine_buffers[1], 0, This->input_channel[i].buffer_size);
+            if (This->input_channel[i].host_buffers[1] && This->input_channel[i].buffer_size > 0) {
+                memset(This->input_channel[i].host_buffers[1], 0, This->input_channel[i].buffer_size);
                 cleared_buffers++;
             }
         }
@@ -968,13 +1734,13 @@ static void clear_audio_buffers(IWineASIOImpl *This, const char *context) {
     /* Clear output channel buffers */
     for (int i = 0; i < This->wineasio_number_outputs; i++) {
         if (This->output_channel[i].active) {
-            /* Clear Wine-allocated buffers with bounds checking */
-            if (This->output_channel[i].wine_buffers[0] && This->output_channel[i].buffer_size > 0) {
-                memset(This->output_channel[i].wine_buffers[0], 0, This->output_channel[i].buffer_size);
+            /* Clear the host buffers with bounds checking */
+            if (This->output_channel[i].host_buffers[0] && This->output_channel[i].buffer_size > 0) {
+                memset(This->output_channel[i].host_buffers[0], 0, This->output_channel[i].buffer_size);
                 cleared_buffers++;
             }
-            if (This->output_channel[i].wine_buffers[1] && This->output_channel[i].buffer_size > 0) {
-                memset(This->output_channel[i].wine_buffers[1], 0, This->output_channel[i].buffer_size);
+            if (This->output_channel[i].host_buffers[1] && This->output_channel[i].buffer_size > 0) {
+                memset(This->output_channel[i].host_buffers[1], 0, This->output_channel[i].buffer_size);
                 cleared_buffers++;
             }
         }
@@ -986,91 +1752,213 @@ static void clear_audio_buffers(IWineASIOImpl *This, const char *context) {
     }
 }
 
+/* Register the port of one channel. Ports exist only for the channels the
+ * host activates (see sync_channel_ports()), under names that depend on the
+ * channel number alone, so that links made by name survive the port coming
+ * and going. Runs with the PipeWire loop locked. */
+static bool add_channel_port(IWineASIOImpl *This, IOChannel *chan, bool is_input) {
+    char pod_buffer[0x1000];
+    struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
+    struct spa_pod const *port_params[2];
+    struct channel_port *port;
+
+    port_params[0] = spa_pod_builder_add_object(&pod_builder,
+        SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+        SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
+        SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
+        // TODO: Check
+        SPA_PARAM_BUFFERS_dataType, SPA_POD_Int(SPA_DATA_MemPtr),
+        //SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(1 << SPA_DATA_MemPtr),
+        SPA_PARAM_BUFFERS_size, SPA_POD_CHOICE_STEP_Int(
+            This->asio_current_buffersize * sizeof(float),
+            This->asio_current_buffersize * sizeof(float),
+            This->asio_current_buffersize * sizeof(float),
+            sizeof(float)
+        ),
+        SPA_PARAM_BUFFERS_stride, SPA_POD_Int(sizeof(float)));
+    port_params[1] = spa_pod_builder_add_object(&pod_builder,
+        SPA_TYPE_OBJECT_ParamIO, SPA_PARAM_IO,
+        SPA_PARAM_IO_id, SPA_POD_Id(SPA_IO_Buffers),
+        SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+
+    port = pw_filter_add_port(This->pw_filter,
+        is_input ? PW_DIRECTION_INPUT : PW_DIRECTION_OUTPUT,
+        PW_FILTER_PORT_FLAG_MAP_BUFFERS,
+        sizeof(struct channel_port),
+        pw_properties_new(
+            PW_KEY_PORT_NAME, chan->port_name,
+            PW_KEY_FORMAT_DSP, JACK_DEFAULT_AUDIO_TYPE,
+            NULL),
+        port_params, ARRAYSIZE(port_params));
+    if (!port) {
+        ERR("Failed to add port %s\n", chan->port_name);
+        return false;
+    }
+    port->chan = chan;
+    port->is_input = is_input;
+    __atomic_store_n(&chan->port, port, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Register the port of interleaved mode for one direction, carrying all of
+ * its configured channels as raw F32 at whatever rate the graph runs. Its
+ * buffers are sized for the largest quantum, so the block adapter can run
+ * on them. Runs with the PipeWire loop locked. */
+static struct channel_port *add_interleaved_port(IWineASIOImpl *This, bool is_input) {
+    uint32_t n_channels = is_input ? This->wineasio_number_inputs : This->wineasio_number_outputs;
+    uint32_t stride = n_channels * sizeof(float);
+    char pod_buffer[0x1000];
+    struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
+    struct spa_audio_info_raw format = SPA_AUDIO_INFO_RAW_INIT(
+        .format = SPA_AUDIO_FORMAT_F32,
+        .flags = SPA_AUDIO_FLAG_UNPOSITIONED,
+        .channels = n_channels,
+    );
+    struct spa_pod const *port_params[3];
+    struct channel_port *port;
+
+    port_params[0] = spa_format_audio_raw_build(&pod_builder, SPA_PARAM_EnumFormat, &format);
+    port_params[1] = spa_pod_builder_add_object(&pod_builder,
+        SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+        SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
+        SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
+        SPA_PARAM_BUFFERS_dataType, SPA_POD_Int(SPA_DATA_MemPtr),
+        SPA_PARAM_BUFFERS_size, SPA_POD_CHOICE_RANGE_Int(
+            PW_BLOCK_ADAPTER_MAX_QUANTUM * stride,
+            This->asio_current_buffersize * stride,
+            PW_BLOCK_ADAPTER_MAX_QUANTUM * stride),
+        SPA_PARAM_BUFFERS_stride, SPA_POD_Int(stride));
+    port_params[2] = spa_pod_builder_add_object(&pod_builder,
+        SPA_TYPE_OBJECT_ParamIO, SPA_PARAM_IO,
+        SPA_PARAM_IO_id, SPA_POD_Id(SPA_IO_Buffers),
+        SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+
+    port = pw_filter_add_port(This->pw_filter,
+        is_input ? PW_DIRECTION_INPUT : PW_DIRECTION_OUTPUT,
+        PW_FILTER_PORT_FLAG_MAP_BUFFERS,
+        sizeof(struct channel_port),
+        pw_properties_new(
+            PW_KEY_PORT_NAME, is_input ? INTERLEAVED_INPUT_PORT : INTERLEAVED_OUTPUT_PORT,
+            NULL),
+        port_params, ARRAYSIZE(port_params));
+    if (!port) {
+        ERR("Failed to add the interleaved %s port for %u channels\n", is_input ? "input" : "output", n_channels);
+        return NULL;
+    }
+    port->is_input = is_input;
+    port->n_channels = n_channels;
+    return port;
+}
+
+/* Unregister the port of one channel, with the loop locked. The data thread
+ * stops seeing it first; pw_filter_remove_port() then waits for the data
+ * loop to let go of it, so a cycle in progress never touches a freed port. */
+static void remove_channel_port(IWineASIOImpl *This, IOChannel *chan) {
+    void *port = chan->port;
+
+    __atomic_store_n(&chan->port, NULL, __ATOMIC_RELEASE);
+    pw_filter_remove_port(port);
+    /* remove_buffer can no longer find the channel by its port */
+    chan->buffers[0] = chan->buffers[1] = NULL;
+    pthread_mutex_lock(&latency_mutex);
+    memset(&chan->latency, 0, sizeof chan->latency);
+    pthread_mutex_unlock(&latency_mutex);
+}
+
+/* Make the ports match the channels the host activated in CreateBuffers():
+ * idle channels cost the graph nothing, not even a port to schedule and mix.
+ * Ports of channels that stay active keep their buffers and links. Runs with
+ * the PipeWire loop locked. */
+static ASIOError sync_channel_ports(IWineASIOImpl *This) {
+    int idx, added = 0, removed = 0;
+
+    /* Interleaved mode: one port per direction for every channel, kept
+     * until Release() */
+    if (This->cycle.interleaved) {
+        for (idx = 0; idx < 2; ++idx) {
+            bool is_input = idx == 0;
+            void **slot = is_input ? &This->cycle.interleaved_inputs : &This->cycle.interleaved_outputs;
+            struct channel_port *port;
+
+            if (*slot || !(is_input ? This->wineasio_number_inputs : This->wineasio_number_outputs))
+                continue;
+            if (!(port = add_interleaved_port(This, is_input)))
+                return ASE_HWMalfunction;
+            __atomic_store_n(slot, port, __ATOMIC_RELEASE);
+            added++;
+        }
+    } else {
+        for (idx = 0; idx < This->wineasio_number_inputs + This->wineasio_number_outputs; ++idx) {
+            IOChannel *chan = &This->input_channel[idx];
+
+            if (chan->active && !chan->port) {
+                if (!add_channel_port(This, chan, idx < This->wineasio_number_inputs))
+                    return ASE_HWMalfunction;
+                added++;
+            } else if (!chan->active && chan->port) {
+                remove_channel_port(This, chan);
+                removed++;
+            }
+        }
+    }
+    if (added) {
+        /* New ports start without SPA_PARAM_Latency, publish it again */
+        pthread_mutex_lock(&latency_mutex);
+        memset(&This->published_capture, 0, sizeof This->published_capture);
+        memset(&This->published_playback, 0, sizeof This->published_playback);
+        pthread_mutex_unlock(&latency_mutex);
+    }
+    if (added || removed)
+        TRACE("Ports follow the active channels: %d added, %d removed\n", added, removed);
+    return ASE_OK;
+}
+
 static ASIOError InitPorts(IWineASIOImpl *This) {
+    int n_channels = This->wineasio_number_inputs + This->wineasio_number_outputs;
     int idx;
-    char pod_buffer[0x1000];
-    struct spa_pod_builder pod_builder;
 
-    /* Allocate IOChannel structures */
-    This->input_channel = HeapAlloc(GetProcessHeap(), 0, (This->wineasio_number_inputs + This->wineasio_number_outputs) * sizeof(IOChannel));
+    /* Allocate IOChannel structures, followed by the room for two routing
+     * plans over them and the plane pointers of the interleaved ports */
+    This->input_channel = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                    n_channels * (sizeof(IOChannel) + 2 * sizeof(struct pw_cycle_route) +
+                                                  sizeof(float *)));
     if (!This->input_channel)
     {
         ERR("Unable to allocate IOChannel structures for %i channels\n", This->wineasio_number_inputs + This->wineasio_number_outputs);
         return ASE_NoMemory;
     }
     This->output_channel = This->input_channel + This->wineasio_number_inputs;
+    This->cycle.ops = &cycle_ops;
+    This->cycle.data = This;
+    This->cycle.inputs = This->input_channel;
+    This->cycle.outputs = This->output_channel;
+    This->cycle.n_inputs = This->wineasio_number_inputs;
+    This->cycle.n_outputs = This->wineasio_number_outputs;
+    This->cycle.routes = (struct pw_cycle_route *)(This->input_channel + n_channels);
+    This->cycle.input_planes = (float **)(This->cycle.routes + 2 * n_channels);
+    This->cycle.output_planes = (float const **)(This->cycle.input_planes + This->wineasio_number_inputs);
+    This->cycle.plan = NULL;
+    This->cycle.interleaved = This->pwasio_interleaved_ports;
+    This->cycle.interleaved_inputs = This->cycle.interleaved_outputs = NULL;
+    This->cycle.late_policy = This->pwasio_late_policy;
+    This->cycle.input_format = This->pwasio_input_format;
+    This->cycle.output_format = This->pwasio_output_format;
+    This->cycle.convert = pw_convert_best();
+    printf("Host sample formats: input %s, output %s, %s conversion\n", pw_sample_format_name(This->pwasio_input_format),
+           pw_sample_format_name(This->pwasio_output_format), pw_convert_isa_name(This->cycle.convert->isa));
     TRACE("%i IOChannel structures allocated\n", This->wineasio_number_inputs + This->wineasio_number_outputs);
 
-    /* Set up ports */
-    pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
-
-    struct spa_pod const *port_params[] = {
-        spa_pod_builder_add_object(&pod_builder,
-            SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
-            SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
-            SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
-            // TODO: Check
-            SPA_PARAM_BUFFERS_dataType, SPA_POD_Int(SPA_DATA_MemPtr),
-            //SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(1 << SPA_DATA_MemPtr),
-            SPA_PARAM_BUFFERS_size, SPA_POD_CHOICE_STEP_Int(
-                This->asio_current_buffersize * sizeof(float),
-                This->asio_current_buffersize * sizeof(float),
-                This->asio_current_buffersize * sizeof(float),
-                sizeof(float)
-            ),
-            SPA_PARAM_BUFFERS_stride, SPA_POD_Int(sizeof(float))
-        ),
-        spa_pod_builder_add_object(&pod_builder,
-            SPA_TYPE_OBJECT_ParamIO, SPA_PARAM_IO,
-            SPA_PARAM_IO_id, SPA_POD_Id(SPA_IO_Buffers),
-            SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers))
-        ),
-    };
-
-    //char port_name[32];
+    /* Ports are added by CreateBuffers() for the channels the host activates,
+     * or once per direction in interleaved mode */
     #define INPUT_PORT_PREFIX "input_"
-    //memcpy(port_name, INPUT_PORT_PREFIX, sizeof(INPUT_PORT_PREFIX));
     for (idx = 0; idx < This->wineasio_number_inputs; ++idx) {
-        //snprintf(port_name + sizeof(INPUT_PORT_PREFIX), sizeof(port_name) - sizeof(INPUT_PORT_PREFIX), "%d", idx);
         snprintf(This->input_channel[idx].port_name, ASIO_MAX_NAME_LENGTH, INPUT_PORT_PREFIX "%d", idx);
-        
-        /* Initialize Wine buffer management fields */
-        This->input_channel[idx].wine_buffers[0] = NULL;
-        This->input_channel[idx].wine_buffers[1] = NULL;
-        This->input_channel[idx].buffer_size = 0;
         This->input_channel[idx].needs_copy = true;
-        
-        This->input_channel[idx].port = pw_filter_add_port(This->pw_filter,
-            PW_DIRECTION_INPUT,
-            PW_FILTER_PORT_FLAG_MAP_BUFFERS,
-            0,
-            pw_properties_new(
-                PW_KEY_PORT_NAME, This->input_channel[idx].port_name,
-                PW_KEY_FORMAT_DSP, JACK_DEFAULT_AUDIO_TYPE,
-                NULL),
-            port_params, ARRAYSIZE(port_params));
     }
     #define OUTPUT_PORT_PREFIX "output_"
-    //memcpy(port_name, OUTPUT_PORT_PREFIX, sizeof(OUTPUT_PORT_PREFIX));
     for (idx = 0; idx < This->wineasio_number_outputs; ++idx) {
-        //snprintf(port_name + sizeof(OUTPUT_PORT_PREFIX), sizeof(port_name) - sizeof(OUTPUT_PORT_PREFIX), "%d", idx);
         snprintf(This->output_channel[idx].port_name, ASIO_MAX_NAME_LENGTH, OUTPUT_PORT_PREFIX "%d", idx);
-        
-        /* Initialize Wine buffer management fields */
-        This->output_channel[idx].wine_buffers[0] = NULL;
-        This->output_channel[idx].wine_buffers[1] = NULL;
-        This->output_channel[idx].buffer_size = 0;
         This->output_channel[idx].needs_copy = true;
-        
-        This->output_channel[idx].port = pw_filter_add_port(This->pw_filter,
-            PW_DIRECTION_OUTPUT,
-            PW_FILTER_PORT_FLAG_MAP_BUFFERS,
-            0,
-            pw_properties_new(
-                PW_KEY_PORT_NAME, This->output_channel[idx].port_name,
-                PW_KEY_FORMAT_DSP, JACK_DEFAULT_AUDIO_TYPE,
-                NULL),
-            port_params, ARRAYSIZE(port_params));
     }
     TRACE("%i IOChannel structures initialized\n", This->wineasio_number_inputs + This->wineasio_number_outputs);
 
@@ -1100,10 +1988,26 @@ HIDDEN ASIOBool STDMETHODCALLTYPE Init(LPWINEASIO iface, void *sysRef)
 
     This->sys_ref = sysRef;
     configure_driver(This);
+    pw_asio_log_start();
 
-    if (!(This->pw_helper = user_pw_create_helper(0, NULL, &init_args)))
+    if (This->pwasio_stats && !This->stats.segment) {
+        int res = pw_stats_create(&This->stats, This->client_name);
+        if (res < 0)
+            printf("Could not create statistics segment: %s\n", strerror(-res));
+        else
+            printf("Publishing statistics in %s\n", This->stats.path);
+    }
+
+    /* The PipeWire connection is shared by all instances in the process and
+     * kept across driver re-opens */
+    if (!This->pw_helper)
     {
-        return ASIOFalse;
+        if (!(This->pw_helper = user_pw_acquire_helper(&init_args)))
+            return ASIOFalse;
+        /* Seeds the baseline under the listener lock, so that no change
+         * slips in between */
+        user_pw_add_settings_listener(This->pw_helper, graph_settings_changed, This,
+                                      &This->settings_quantum, &This->settings_rate);
     }
 
     /* Register the worker callback for deferred PipeWire operations */
@@ -1254,6 +2158,7 @@ HIDDEN ASIOError STDMETHODCALLTYPE Start(LPWINEASIO iface)
     user_pw_lock_loop(This->pw_helper);
     pw_filter_set_active(This->pw_filter, true);
     user_pw_unlock_loop(This->pw_helper);
+    This->filter_left_active = false;
 
     /* Wait for filter to reach streaming state - use longer timeout for small buffer sizes */
     int streaming_timeout = (This->asio_current_buffersize <= 128) ? 8000 : 5000;
@@ -1266,8 +2171,16 @@ HIDDEN ASIOError STDMETHODCALLTYPE Start(LPWINEASIO iface)
     }
 
     /* Initialize ASIO timing and buffer state - ensure clean restart */
-    This->asio_buffer_index = 0;
+    apply_next_sample_rate(This);
     This->asio_sample_position = 0;
+    pw_cycle_reset(&This->cycle, This->asio_current_buffersize, This->asio_sample_rate);
+    memset(&This->stats_cycle, 0, sizeof This->stats_cycle);
+    This->stats_last_start = 0;
+    This->cycle_next_position = 0;
+    This->deadline_misses = 0;
+    /* Latency and clock changes while stopped are still news to the host */
+    __atomic_and_fetch(&This->pending_messages,
+                       PENDING_LATENCIES | PENDING_BUFFER_SIZE | PENDING_SAMPLE_RATE | PENDING_RESET, __ATOMIC_RELAXED);
     /* Initialize timestamp in microseconds (not nanoseconds!) */
     This->asio_time_stamp = timeGetTime() * 1000ULL; /* Convert milliseconds to microseconds */
 
@@ -1292,6 +2205,18 @@ HIDDEN ASIOError STDMETHODCALLTYPE Start(LPWINEASIO iface)
     return ASE_OK;
 }
 
+/* Finish a Stop() that ran inside a direct bufferSwitch: the filter stays
+ * connected across DisposeBuffers(), and a CreateBuffers() would wait in
+ * vain for it to pause */
+static void deactivate_stopped_filter(IWineASIOImpl *This) {
+    if (!This->filter_left_active || tls_in_direct_callback || !This->pw_filter)
+        return;
+    user_pw_lock_loop(This->pw_helper);
+    pw_filter_set_active(This->pw_filter, false);
+    user_pw_unlock_loop(This->pw_helper);
+    This->filter_left_active = false;
+}
+
 /*
  * ASIOError Stop(void);
  *  Function:   Stop JACK IO processing
@@ -1309,6 +2234,17 @@ HIDDEN ASIOError STDMETHODCALLTYPE Stop(LPWINEASIO iface)
     if (This->asio_driver_state != Running)
         return ASE_NotPresent;
 
+    /* Stop() from inside a directly dispatched bufferSwitch runs on the data
+     * thread; deactivating the filter here would deadlock. Stop calling the
+     * host and leave the filter outputting silence until the next Start(),
+     * or until DisposeBuffers() or CreateBuffers() deactivate it. */
+    if (tls_in_direct_callback) {
+        disable_direct_dispatch(This, "host called Stop from inside bufferSwitch");
+        This->filter_left_active = true;
+        This->asio_driver_state = Prepared;
+        return ASE_OK;
+    }
+
     /* Deactivate the PipeWire filter first to stop audio processing */
     user_pw_lock_loop(This->pw_helper);
     pw_filter_set_active(This->pw_filter, false);
@@ -1318,7 +2254,7 @@ HIDDEN ASIOError STDMETHODCALLTYPE Stop(LPWINEASIO iface)
     clear_audio_buffers(This, "driver stop");
 
     /* Reset buffer index to ensure consistent state */
-    This->asio_buffer_index = 0;
+    This->cycle.buffer_index = 0;
 
     This->asio_driver_state = Prepared;
 
@@ -1365,14 +2301,10 @@ HIDDEN ASIOError STDMETHODCALLTYPE GetLatencies(LPWINEASIO iface, LONG *inputLat
     if (This->asio_driver_state == Loaded)
         return ASE_NotPresent;
 
-    /*jack_port_get_latency_range(This->input_channel[0].port, JackCaptureLatency, &range);
-    *inputLatency = range.max;
-    jack_port_get_latency_range(This->output_channel[0].port, JackPlaybackLatency, &range);
-    *outputLatency = range.max;*/
+    compute_latencies(This, inputLatency, outputLatency);
+    This->reported_input_latency = *inputLatency;
+    This->reported_output_latency = *outputLatency;
     TRACE("iface: %p, input latency: %d, output latency: %d\n", iface, *inputLatency, *outputLatency);
-
-    *inputLatency = This->asio_current_buffersize;
-    *outputLatency = This->asio_current_buffersize;
     return ASE_OK;
 }
 
@@ -1410,6 +2342,56 @@ HIDDEN ASIOError STDMETHODCALLTYPE GetBufferSize(LPWINEASIO iface, LONG *minSize
     return ASE_OK;
 }
 
+/* Whether an Int property value, fixed or a choice, allows `value` */
+static bool pod_allows_int(struct spa_pod const *pod, int32_t value) {
+    uint32_t n_values, choice, idx;
+    struct spa_pod const *values = spa_pod_get_values(pod, &n_values, &choice);
+    int32_t const *v;
+
+    if (!values || values->type != SPA_TYPE_Int || !n_values)
+        return true;
+    v = SPA_POD_BODY_CONST(values);
+    switch (choice) {
+        case SPA_CHOICE_None:
+            return v[0] == value;
+        case SPA_CHOICE_Range:
+            return n_values < 3 || (value >= v[1] && value <= v[2]);
+        case SPA_CHOICE_Step:
+            return n_values < 4 || (value >= v[1] && value <= v[2] && (v[3] <= 0 || (value - v[1]) % v[3] == 0));
+        case SPA_CHOICE_Enum:
+            for (idx = 0; idx < n_values; ++idx) {
+                if (v[idx] == value)
+                    return true;
+            }
+            return false;
+        default:
+            return true;
+    }
+}
+
+/* Whether device `node` lists `rate` in its EnumFormat. The first call per
+ * node subscribes to the param and waits one roundtrip. A node that does not
+ * answer in time or does not list rates is taken to allow any. */
+static bool device_allows_rate(IWineASIOImpl *This, struct pw_node *node, int32_t rate) {
+    struct spa_pod *params[16];
+    bool listed = false, allowed = false;
+    int count, idx;
+
+    if (!node)
+        return true;
+    count = user_pw_node_get_params(This->pw_helper, node, SPA_PARAM_EnumFormat, params, SPA_N_ELEMENTS(params), 500);
+    for (idx = 0; idx < count; ++idx) {
+        struct spa_pod_prop const *prop = spa_pod_find_prop(params[idx], NULL, SPA_FORMAT_AUDIO_rate);
+
+        if (prop) {
+            listed = true;
+            allowed = allowed || pod_allows_int(&prop->value, rate);
+        }
+        free(params[idx]);
+    }
+    return !listed || allowed;
+}
+
 /*
  * ASIOError CanSampleRate(ASIOSampleRate sampleRate);
  *  Function:   Ask if specific SR is available
@@ -1423,8 +2405,13 @@ HIDDEN ASIOError STDMETHODCALLTYPE CanSampleRate(LPWINEASIO iface, ASIOSampleRat
 
     TRACE("iface: %p, Samplerate = %li, requested samplerate = %li\n", iface, (long) This->asio_sample_rate, (long) sampleRate);
 
-    //if (sampleRate != This->asio_sample_rate)
-    //    return ASE_NoClock;
+    /* The graph can run at any rate; report the ones the devices have */
+    if (!This->pw_helper)
+        return ASE_OK;
+    get_nodes_by_name(This);
+    if (!device_allows_rate(This, This->current_input_node, (int32_t)sampleRate) ||
+        !device_allows_rate(This, This->current_output_node, (int32_t)sampleRate))
+        return ASE_NoClock;
     return ASE_OK;
 }
 
@@ -1445,7 +2432,10 @@ HIDDEN ASIOError STDMETHODCALLTYPE GetSampleRate(LPWINEASIO iface, ASIOSampleRat
     if (!sampleRate)
         return ASE_InvalidParameter;
 
-    *sampleRate = This->asio_sample_rate;
+    /* A rate already announced with sampleRateDidChange() */
+    *sampleRate = __atomic_load_n(&This->next_sample_rate, __ATOMIC_RELAXED);
+    if (!*sampleRate)
+        *sampleRate = This->asio_sample_rate;
     return ASE_OK;
 }
 
@@ -1464,7 +2454,17 @@ HIDDEN ASIOError STDMETHODCALLTYPE SetSampleRate(LPWINEASIO iface, ASIOSampleRat
 
     TRACE("iface: %p, Sample rate %f requested\n", iface, sampleRate);
 
-    This->asio_sample_rate = sampleRate;
+    /* While running, the data thread keeps the old rate until the next
+     * Stop()/Start() */
+    if (This->asio_driver_state == Running) {
+        __atomic_store_n(&This->next_sample_rate, (uint32_t)sampleRate, __ATOMIC_RELAXED);
+    } else {
+        This->asio_sample_rate = sampleRate;
+        __atomic_store_n(&This->next_sample_rate, 0, __ATOMIC_RELAXED);
+    }
+    /* With buffers in place, move the graph along */
+    if (This->asio_driver_state >= Prepared)
+        apply_graph_clock(This);
     return ASE_OK;
 }
 
@@ -1538,6 +2538,19 @@ HIDDEN ASIOError STDMETHODCALLTYPE GetSamplePosition(LPWINEASIO iface, ASIOSampl
     return ASE_OK;
 }
 
+/* ASIO type of a host sample format, all little endian */
+static ASIOSampleType asio_sample_type(enum pw_sample_format format)
+{
+    switch (format)
+    {
+        case PW_SAMPLE_INT16:   return ASIOSTInt16LSB;
+        case PW_SAMPLE_INT24:   return ASIOSTInt24LSB;
+        case PW_SAMPLE_INT32:   return ASIOSTInt32LSB;
+        case PW_SAMPLE_FLOAT64: return ASIOSTFloat64LSB;
+        default:                return ASIOSTFloat32LSB;
+    }
+}
+
 /*
  * ASIOError GetChannelInfo (ASIOChannelInfo *info);
  *  Function:   Retrive channel info. - See asio.h for more detail
@@ -1555,7 +2568,7 @@ HIDDEN ASIOError STDMETHODCALLTYPE GetChannelInfo(LPWINEASIO iface, ASIOChannelI
         return ASE_InvalidParameter;
 
     info->channelGroup = 0;
-    info->type = ASIOSTFloat32LSB;
+    info->type = asio_sample_type(info->isInput ? This->pwasio_input_format : This->pwasio_output_format);
 
     if (info->isInput)
     {
@@ -1570,6 +2583,78 @@ HIDDEN ASIOError STDMETHODCALLTYPE GetChannelInfo(LPWINEASIO iface, ASIOChannelI
     return ASE_OK;
 }
 
+/* Bytes per sample of the wider host sample format */
+static inline size_t widest_sample_size(IWineASIOImpl const *This) {
+    uint32_t input = pw_sample_format_size(This->pwasio_input_format);
+    uint32_t output = pw_sample_format_size(This->pwasio_output_format);
+    return input > output ? input : output;
+}
+
+/* Map one arena for the host buffers of every active channel that copies.
+ * Each half is one contiguous run of inputs then outputs in channel order, so
+ * a cycle walks it front to back. */
+static bool alloc_buffer_arena(IWineASIOImpl *This, size_t buffer_bytes) {
+    size_t stride = ALIGN_TO_CACHE_LINE(buffer_bytes);
+    size_t count = 0, slot = 0;
+    int    idx, half, res;
+
+    pw_arena_clear(&This->buffer_arena);
+    for (idx = 0; idx < This->wineasio_number_inputs + This->wineasio_number_outputs; ++idx) {
+        if (This->input_channel[idx].active && This->input_channel[idx].needs_copy)
+            count++;
+    }
+    if (!count)
+        return true;
+
+    if ((res = pw_arena_init(&This->buffer_arena, 2 * count * stride, This->pwasio_hugepages)) < 0) {
+        ERR("Failed to map %zu byte ASIO buffer arena: %s\n", 2 * count * stride, strerror(-res));
+        return false;
+    }
+    if (!This->buffer_arena.locked)
+        WARN("Could not lock the ASIO buffer arena in memory, raise the memlock limit to avoid page faults\n");
+    printf("ASIO buffer arena: %zu channels, %zu bytes%s%s\n", count, This->buffer_arena.size,
+           This->buffer_arena.huge ? ", huge pages" : "", This->buffer_arena.locked ? ", locked" : "");
+
+    /* input_channel and output_channel are one array, inputs first */
+    for (idx = 0; idx < This->wineasio_number_inputs + This->wineasio_number_outputs; ++idx) {
+        IOChannel *chan = &This->input_channel[idx];
+        if (!chan->active || !chan->needs_copy)
+            continue;
+        for (half = 0; half < 2; ++half)
+            chan->host_buffers[half] = (char *)This->buffer_arena.base + (half * count + slot) * stride;
+        slot++;
+    }
+    return true;
+}
+
+/* Undo the per-channel work of CreateBuffers(): stop routing, free the block
+ * adapter rings and the arena and deactivate every channel */
+static void release_host_buffers(IWineASIOImpl *This) {
+    int idx;
+
+    pw_cycle_clear_plan(&This->cycle);
+
+    /* input_channel and output_channel are one array, inputs first */
+    for (idx = 0; idx < This->wineasio_number_inputs + This->wineasio_number_outputs; ++idx) {
+        IOChannel *chan = &This->input_channel[idx];
+
+        chan->host_buffers[0] = NULL;
+        chan->host_buffers[1] = NULL;
+        chan->needs_copy = true;
+
+        if (chan->ring_data) {
+            HeapFree(GetProcessHeap(), 0, chan->ring_data);
+            chan->ring_data = NULL;
+        }
+
+        chan->active = false;
+    }
+    This->asio_active_inputs = This->asio_active_outputs = 0;
+    __atomic_store_n(&This->zero_copy_waiting, false, __ATOMIC_RELAXED);
+
+    pw_arena_clear(&This->buffer_arena);
+}
+
 /*
  * ASIOError CreateBuffers(ASIOBufferInfo *bufferInfo, LONG numChannels, LONG bufferSize, ASIOCallbacks *asioCallbacks);
  *  Function:   Allocate buffers for IO channels
@@ -1599,6 +2684,9 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
     if (!bufferInfo || !asioCallbacks)
         return ASE_InvalidMode;
 
+    /* DisposeBuffers() from inside bufferSwitch could not do it either */
+    deactivate_stopped_filter(This);
+
     /* Check for invalid channel numbers */
     #if 0
     for (i = j = k = 0; i < numChannels; i++, buffer_info++)
@@ -1657,26 +2745,37 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
         }
         else
         {
-            /* Use our configured buffer size instead of what the application requested */
-            printf("ASIO application requested %d samples, using configured %d samples instead\n", 
+            /* The graph follows, see request_graph_clock() */
+            printf("ASIO application requested %d samples, was %d\n",
                    (int)bufferSize, (int)This->asio_current_buffersize);
-            TRACE("Buffer size forced to configured value: %i\n", (int)This->asio_current_buffersize);
+            This->asio_current_buffersize = bufferSize;
+            TRACE("Buffer size set to %i\n", (int)This->asio_current_buffersize);
         }
     }
 
     /* print/discover ASIO host capabilities */
     This->asio_callbacks = asioCallbacks;
     This->asio_time_info_mode = This->asio_can_time_code = FALSE;
+    This->direct_dispatch_disabled = false;
+    This->direct_dispatch_overruns = 0;
+    This->zero_copy_lost = false;
 
     TRACE("The ASIO host supports ASIO v%i: ", This->asio_callbacks->asioMessage(kAsioEngineVersion, 0, 0, 0));
-    if (This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioBufferSizeChange, 0 , 0))
+    This->host_handles_buffer_size = This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioBufferSizeChange, 0 , 0);
+    if (This->host_handles_buffer_size)
         TRACE("kAsioBufferSizeChange ");
-    if (This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioResetRequest, 0 , 0))
+    This->host_handles_reset = This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioResetRequest, 0 , 0);
+    if (This->host_handles_reset)
         TRACE("kAsioResetRequest ");
-    if (This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioResyncRequest, 0 , 0))
+    This->host_handles_resync = This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioResyncRequest, 0 , 0);
+    if (This->host_handles_resync)
         TRACE("kAsioResyncRequest ");
-    if (This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioLatenciesChanged, 0 , 0))
+    This->host_handles_latencies = This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioLatenciesChanged, 0 , 0);
+    if (This->host_handles_latencies)
         TRACE("kAsioLatenciesChanged ");
+    This->host_handles_overload = This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioOverload, 0 , 0);
+    if (This->host_handles_overload)
+        TRACE("kAsioOverload ");
 
     if (This->asio_callbacks->asioMessage(kAsioSupportsTimeInfo, 0, 0, 0))
     {
@@ -1720,39 +2819,28 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
         }
 
         chan->active = true;
-        chan->buffers[0] = NULL;
-        chan->buffers[1] = NULL;
+    }
+
+    /* Ports for exactly the active channels, with our own latency before any
+     * peer has told us theirs */
+    user_pw_lock_loop(This->pw_helper);
+    status = sync_channel_ports(This);
+    if (status == ASE_OK)
+        publish_port_latencies(This);
+    user_pw_unlock_loop(This->pw_helper);
+    if (status != ASE_OK) {
+        release_host_buffers(This);
+        return status;
     }
 
     /* Connect PipeWire filter only if not already connected */
     if (This->pw_filter && pw_filter_get_state(This->pw_filter, NULL) == PW_FILTER_STATE_UNCONNECTED) {
-        /* PipeWire quantum should be pre-configured by GUI for optimal sync */
-        printf("Connecting filter with %d samples (quantum should be pre-configured)\n", This->asio_current_buffersize);
+        printf("Connecting filter with %d samples\n", This->asio_current_buffersize);
         
-        char pod_buffer[0x1000];
+        uint8_t pod_buffer[0x1000];
         struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
-        struct spa_audio_info_raw format = SPA_AUDIO_INFO_RAW_INIT(
-            .format = SPA_AUDIO_FORMAT_F32,
-            .rate = This->asio_sample_rate,
-            .channels = This->asio_active_outputs,
-        );
-        
-        /* Calculate latency in nanoseconds from buffer size and sample rate */
-        uint64_t latency_ns = (uint64_t)This->asio_current_buffersize * SPA_NSEC_PER_SEC / (uint64_t)This->asio_sample_rate;
-        
-        /* Add timing constraints to ensure consistent buffer sizes */
-        struct spa_pod const *connect_params[] = {
-            spa_format_audio_raw_build(&pod_builder, SPA_PARAM_EnumFormat, &format),
-            spa_process_latency_build(&pod_builder, SPA_PARAM_ProcessLatency,
-                &SPA_PROCESS_LATENCY_INFO_INIT(.ns = latency_ns)),
-            spa_pod_builder_add_object(&pod_builder,
-                SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
-                SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
-                SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
-                SPA_PARAM_BUFFERS_size, SPA_POD_Int(This->asio_current_buffersize * sizeof(float)),
-                SPA_PARAM_BUFFERS_stride, SPA_POD_Int(sizeof(float))
-            ),
-        };
+        struct spa_pod const *connect_params[3];
+        uint32_t n_params = build_filter_params(This, &pod_builder, connect_params);
         
         TRACE("Connecting PipeWire filter with rate=%f, channels=%d\n", This->asio_sample_rate, This->asio_active_outputs);
         printf("Connecting PipeWire filter with %d samples (%.2f ms) at %.0f Hz\n", 
@@ -1761,11 +2849,13 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
                This->asio_sample_rate);
         
         user_pw_lock_loop(This->pw_helper);
-        if (pw_filter_connect(This->pw_filter, PW_FILTER_FLAG_RT_PROCESS, connect_params, ARRAYSIZE(connect_params)) < 0) {
+        if (pw_filter_connect(This->pw_filter, PW_FILTER_FLAG_RT_PROCESS | PW_FILTER_FLAG_CUSTOM_LATENCY, connect_params, n_params) < 0) {
             user_pw_unlock_loop(This->pw_helper);
             ERR("Failed to connect PipeWire filter\n");
+            release_host_buffers(This);
             return ASE_HWMalfunction;
         }
+        request_graph_clock(This, true);
         user_pw_unlock_loop(This->pw_helper);
         
         TRACE("PipeWire filter connected successfully\n");
@@ -1773,6 +2863,7 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
     } else if (This->pw_filter) {
         TRACE("PipeWire filter already connected, state: %s\n", 
               pw_filter_state_as_string(pw_filter_get_state(This->pw_filter, NULL)));
+        apply_graph_clock(This);
     }
 
     /* Wait for filter to reach paused state - use longer timeout for small buffer sizes */
@@ -1783,6 +2874,7 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
     if (!user_pw_wait_for_filter_state(This->pw_helper, This->pw_filter, PW_FILTER_STATE_PAUSED, paused_timeout)) {
         ERR("Timeout waiting for PipeWire filter to reach paused state\n");
         printf("Timeout waiting for PipeWire filter to reach paused state\n");
+        release_host_buffers(This);
         return ASE_HWMalfunction;
     }
     TRACE("PipeWire filter successfully reached paused state\n");
@@ -1792,6 +2884,8 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
     for (i = 0; i < numChannels; i++, buffer_info++)
     {
         IOChannel *chan;
+        uint32_t   ring_capacity;
+        bool       zero_copy;
         if (buffer_info->isInput)
         {
             chan = &This->input_channel[buffer_info->channelNum];
@@ -1805,37 +2899,70 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
 
         TRACE("Channel idx %d: buffer 0: %p, buffer 1: %p\n", i, chan->buffers[0], chan->buffers[1]);
         
-        /* Allocate Wine-compatible buffers with optimal alignment for performance */
-        chan->buffer_size = bufferSize * sizeof(float);
-        
-        /* Align to cache line boundaries and ensure power-of-2 alignment for SIMD */
-        size_t aligned_size = ALIGN_TO_CACHE_LINE(chan->buffer_size);
-        
-        chan->wine_buffers[0] = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, aligned_size);
-        chan->wine_buffers[1] = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, aligned_size);
-        
-        if (!chan->wine_buffers[0] || !chan->wine_buffers[1]) {
-            ERR("Failed to allocate Wine-compatible buffers for channel %d\n", i);
+        chan->buffer_size = bufferSize * pw_sample_format_size(buffer_info->isInput ? This->pwasio_input_format
+                                                                                    : This->pwasio_output_format);
+
+        /* Block adapter ring, sized for the largest graph quantum so that a
+         * quantum change never allocates on the data thread */
+        ring_capacity = pw_block_adapter_capacity(This->asio_current_buffersize);
+        chan->ring_data = HeapAlloc(GetProcessHeap(), 0, ring_capacity * sizeof(float));
+        if (!chan->ring_data) {
+            ERR("Failed to allocate block adapter ring for channel %d\n", i);
+            release_host_buffers(This);
             return ASE_NoMemory;
         }
-        
-        /* Always use copying for stability - direct buffer access can cause issues */
-        chan->needs_copy = true;
-        
-        TRACE("Channel %d: Allocated %zu byte buffers (aligned from %zu)\n", i, aligned_size, chan->buffer_size);
-        
-        /* Provide Wine-allocated buffers to ASIO application */
-        buffer_info->buffers[0] = chan->wine_buffers[0];
-        buffer_info->buffers[1] = chan->wine_buffers[1];
-        
-        TRACE("Channel %d: Wine buffers allocated at %p, %p (size=%zu)\n", 
-              i, chan->wine_buffers[0], chan->wine_buffers[1], chan->buffer_size);
+        pw_ring_init(&chan->ring, chan->ring_data, ring_capacity);
+
+        /* Zero-copy: the host writes straight into the output port's two
+         * mapped buffers, which takes F32 host buffers. Inputs are the link's
+         * buffers, shared with the peer, and are always copied.
+         *
+         * A port sync_channel_ports() just added has no buffers until it is
+         * linked and negotiated, which the paused wait above does not cover.
+         * Its channel copies, and the host is reset once the buffers are
+         * there (see pipewire_add_buffer_callback()). */
+        zero_copy = This->pwasio_zero_copy && !buffer_info->isInput &&
+                    This->pwasio_output_format == PW_SAMPLE_FLOAT32;
+        user_pw_lock_loop(This->pw_helper);
+        chan->needs_copy = !(zero_copy && zero_copy_usable(chan, chan->buffer_size));
+        if (zero_copy && chan->needs_copy && (!chan->buffers[0] || !chan->buffers[1]))
+            __atomic_store_n(&This->zero_copy_waiting, true, __ATOMIC_RELAXED);
+        if (!chan->needs_copy) {
+            chan->host_buffers[0] = chan->buffers[0]->buffer->datas[0].data;
+            chan->host_buffers[1] = chan->buffers[1]->buffer->datas[0].data;
+        }
+        user_pw_unlock_loop(This->pw_helper);
+
+        if (!chan->needs_copy)
+            TRACE("Channel %d: Using mapped port buffers %p, %p (zero-copy)\n", i, chan->host_buffers[0], chan->host_buffers[1]);
+    }
+
+    /* All other channels live in one locked arena, with room for the wider
+     * sample format of the two directions */
+    if (!alloc_buffer_arena(This, bufferSize * widest_sample_size(This))) {
+        release_host_buffers(This);
+        return ASE_NoMemory;
+    }
+
+    /* Provide the host buffers to the ASIO application */
+    buffer_info = bufferInfo;
+    for (i = 0; i < numChannels; i++, buffer_info++)
+    {
+        IOChannel *chan = buffer_info->isInput ? &This->input_channel[buffer_info->channelNum]
+                                               : &This->output_channel[buffer_info->channelNum];
+        buffer_info->buffers[0] = chan->host_buffers[0];
+        buffer_info->buffers[1] = chan->host_buffers[1];
     }
     TRACE("%i audio channels initialized\n", This->asio_active_inputs + This->asio_active_outputs);
 
     /* Ensure all newly allocated buffers are clean for consistent initial state */
     clear_audio_buffers(This, "buffer creation");
 
+    /* The data thread only ever walks the channels routed here */
+    pw_cycle_build_plan(&This->cycle, This->asio_current_buffersize);
+    TRACE("Routing %d inputs, %d copied and %d zero-copy outputs, %d outputs silent\n",
+          This->cycle.plan->n_inputs, This->cycle.plan->n_copied, This->cycle.plan->n_mapped, This->cycle.plan->n_silent);
+
     #if 0
     This->callback_audio_buffer = HeapAlloc(GetProcessHeap(), 0,
         (This->wineasio_number_inputs + This->wineasio_number_outputs) * 2 * This->asio_current_buffersize * sizeof(jack_default_audio_sample_t));
@@ -1868,6 +2995,7 @@ HIDDEN ASIOError STDMETHODCALLTYPE CreateBuffers(LPWINEASIO iface, ASIOBufferInf
     /* Initialize ASIO callback manager for Wine thread marshalling */
     if (!init_asio_callback_manager(This)) {
         ERR("Failed to initialize ASIO callback manager\n");
+        release_host_buffers(This);
         return ASE_HWMalfunction;
     }
 
@@ -1897,57 +3025,35 @@ HIDDEN ASIOError STDMETHODCALLTYPE DisposeBuffers(LPWINEASIO iface)
     if (This->asio_driver_state != Prepared)
         return ASE_NotPresent;
 
-    /* Properly disconnect and destroy the PipeWire filter */
+    deactivate_stopped_filter(This);
+    pw_cycle_clear_plan(&This->cycle);
+
+    /* The host is done with its buffers, losing the port buffers behind a
+     * zero-copy channel from here on is expected */
+    for (i = 0; i < This->wineasio_number_inputs + This->wineasio_number_outputs; i++)
+        This->input_channel[i].needs_copy = true;
+
+    /* The filter, its ports, their buffers and links stay as they are until
+     * Release(), so that the CreateBuffers() of a host reset only has to
+     * swap the arena and the active channels. The graph is free to run at
+     * another clock meanwhile. */
     if (This->pw_filter) {
         user_pw_lock_loop(This->pw_helper);
-        pw_filter_disconnect(This->pw_filter);
+        request_graph_clock(This, false);
         user_pw_unlock_loop(This->pw_helper);
-        
-        /* Wait for filter to reach disconnected state */
-        user_pw_wait_for_filter_state(This->pw_helper, This->pw_filter, PW_FILTER_STATE_UNCONNECTED, 5000);
-        
-        pw_filter_destroy(This->pw_filter);
-        This->pw_filter = NULL;
-        TRACE("PipeWire filter properly disconnected and destroyed\n");
     }
 
+    /* The graph moved on while we had buffers, the next ones follow it */
+    if (This->next_buffersize) {
+        if (This->next_buffersize != (uint32_t)This->asio_current_buffersize)
+            printf("Buffer size follows the graph: %u samples\n", This->next_buffersize);
+        This->asio_current_buffersize = This->next_buffersize;
+        This->next_buffersize = 0;
+    }
+    apply_next_sample_rate(This);
     This->asio_callbacks = NULL;
 
-    for (i = 0; i < This->wineasio_number_inputs; i++)
-    {
-        This->input_channel[i].buffers[0] = NULL;
-        This->input_channel[i].buffers[1] = NULL;
-        
-        /* Free Wine-allocated buffers */
-        if (This->input_channel[i].wine_buffers[0]) {
-            HeapFree(GetProcessHeap(), 0, This->input_channel[i].wine_buffers[0]);
-            This->input_channel[i].wine_buffers[0] = NULL;
-        }
-        if (This->input_channel[i].wine_buffers[1]) {
-            HeapFree(GetProcessHeap(), 0, This->input_channel[i].wine_buffers[1]);
-            This->input_channel[i].wine_buffers[1] = NULL;
-        }
-        
-        This->input_channel[i].active = false;
-    }
-    for (i = 0; i < This->wineasio_number_outputs; i++)
-    {
-        This->output_channel[i].buffers[0] = NULL;
-        This->output_channel[i].buffers[1] = NULL;
-        
-        /* Free Wine-allocated buffers */
-        if (This->output_channel[i].wine_buffers[0]) {
-            HeapFree(GetProcessHeap(), 0, This->output_channel[i].wine_buffers[0]);
-            This->output_channel[i].wine_buffers[0] = NULL;
-        }
-        if (This->output_channel[i].wine_buffers[1]) {
-            HeapFree(GetProcessHeap(), 0, This->output_channel[i].wine_buffers[1]);
-            This->output_channel[i].wine_buffers[1] = NULL;
-        }
-        
-        This->output_channel[i].active = false;
-    }
-    This->asio_active_inputs = This->asio_active_outputs = 0;
+    release_host_buffers(This);
 
     //if (This->callback_audio_buffer)
     //    HeapFree(GetProcessHeap(), 0, This->callback_audio_buffer);
@@ -1993,179 +3099,15 @@ HIDDEN void GuiApplyConfig(struct pwasio_gui_conf *conf)
     printf("GUI: Applying configuration changes - driver state: %d\n", This->asio_driver_state);
     printf("GUI: Current buffer size: %ld, requested: %u\n", This->wineasio_preferred_buffersize, conf->cf_buffer_size);
     
-    // Update buffer size preference and current buffer size
-    if (This->wineasio_preferred_buffersize != conf->cf_buffer_size) {
-        TRACE("Changing buffer size from %ld to %u\n", This->wineasio_preferred_buffersize, conf->cf_buffer_size);
-        printf("GUI: Changing buffer size from %ld to %u\n", This->wineasio_preferred_buffersize, conf->cf_buffer_size);
+    // Buffer size and sample rate go through the reconfiguration engine
+    if (This->wineasio_preferred_buffersize != conf->cf_buffer_size ||
+        This->asio_current_buffersize != conf->cf_buffer_size || This->asio_sample_rate != conf->cf_sample_rate) {
+        printf("GUI: Changing buffer size from %d to %u and sample rate from %.0f to %u\n",
+               (int)This->asio_current_buffersize, conf->cf_buffer_size, This->asio_sample_rate, conf->cf_sample_rate);
         This->wineasio_preferred_buffersize = conf->cf_buffer_size;
-        
-        // Also update the current buffer size if driver is not in a prepared/running state
-        // If buffers are already created, we need to notify the host to recreate them
-        if (This->asio_driver_state == Initialized || This->asio_driver_state == Loaded) {
-            This->asio_current_buffersize = conf->cf_buffer_size;
-            TRACE("Updated current buffer size to %u\n", conf->cf_buffer_size);
-            printf("GUI: Updated current buffer size to %u (driver not prepared)\n", conf->cf_buffer_size);
-        } else if (This->asio_driver_state == Prepared || This->asio_driver_state == Running) {
-            // Update current buffer size immediately
-            This->asio_current_buffersize = conf->cf_buffer_size;
-            TRACE("Updated current buffer size to %u (driver prepared/running)\n", conf->cf_buffer_size);
-            printf("GUI: Updated current buffer size to %u (driver prepared/running)\n", conf->cf_buffer_size);
-            
-            // If PipeWire filter is connected, we need to reconnect it with the new buffer size
-            if (This->pw_filter && pw_filter_get_state(This->pw_filter, NULL) != PW_FILTER_STATE_UNCONNECTED) {
-                TRACE("Reconnecting PipeWire filter with new buffer size\n");
-                printf("GUI: Reconnecting PipeWire filter with new buffer size\n");
-                
-                // Disconnect the current filter
-                user_pw_lock_loop(This->pw_helper);
-                pw_filter_disconnect(This->pw_filter);
-                user_pw_unlock_loop(This->pw_helper);
-                
-                // Wait for disconnection
-                user_pw_wait_for_filter_state(This->pw_helper, This->pw_filter, PW_FILTER_STATE_UNCONNECTED, 5000);
-                
-                // Reconnect with new buffer size
-                char pod_buffer[0x1000];
-                struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
-                struct spa_audio_info_raw format = SPA_AUDIO_INFO_RAW_INIT(
-                    .format = SPA_AUDIO_FORMAT_F32,
-                    .rate = This->asio_sample_rate,
-                    .channels = This->asio_active_outputs,
-                );
-                
-                /* Calculate latency in nanoseconds from new buffer size and sample rate */
-                uint64_t latency_ns = (uint64_t)This->asio_current_buffersize * SPA_NSEC_PER_SEC / (uint64_t)This->asio_sample_rate;
-                
-                /* Add timing constraints to ensure consistent buffer sizes */
-                struct spa_pod const *connect_params[] = {
-                    spa_format_audio_raw_build(&pod_builder, SPA_PARAM_EnumFormat, &format),
-                    spa_process_latency_build(&pod_builder, SPA_PARAM_ProcessLatency,
-                        &SPA_PROCESS_LATENCY_INFO_INIT(.ns = latency_ns)),
-                    spa_pod_builder_add_object(&pod_builder,
-                        SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
-                        SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
-                        SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
-                        SPA_PARAM_BUFFERS_size, SPA_POD_Int(This->asio_current_buffersize * sizeof(float)),
-                        SPA_PARAM_BUFFERS_stride, SPA_POD_Int(sizeof(float))
-                    ),
-                };
-                
-                printf("GUI: Reconnecting PipeWire with new quantum: %d samples (%.2f ms) at %.0f Hz\n", 
-                       This->asio_current_buffersize, 
-                       (double)This->asio_current_buffersize * 1000.0 / This->asio_sample_rate,
-                       This->asio_sample_rate);
-                
-                user_pw_lock_loop(This->pw_helper);
-                if (pw_filter_connect(This->pw_filter, PW_FILTER_FLAG_RT_PROCESS, connect_params, ARRAYSIZE(connect_params)) < 0) {
-                    user_pw_unlock_loop(This->pw_helper);
-                    ERR("Failed to reconnect PipeWire filter with new buffer size\n");
-                    printf("GUI: ERROR - Failed to reconnect PipeWire filter with new buffer size\n");
-                } else {
-                    user_pw_unlock_loop(This->pw_helper);
-                    
-                    // Wait for filter to reach paused state
-                    if (user_pw_wait_for_filter_state(This->pw_helper, This->pw_filter, PW_FILTER_STATE_PAUSED, 10000)) {
-                        TRACE("PipeWire filter successfully reconnected with new buffer size\n");
-                        printf("GUI: PipeWire filter successfully reconnected with new buffer size\n");
-                    } else {
-                        ERR("Timeout waiting for PipeWire filter to reach paused state after reconnection\n");
-                        printf("GUI: ERROR - Timeout waiting for PipeWire filter to reach paused state after reconnection\n");
-                    }
-                }
-            } else {
-                printf("GUI: PipeWire filter not connected or already disconnected\n");
-            }
-            
-            // Buffers are already created, need to notify host about buffer size change
-            if (This->asio_callbacks && This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioBufferSizeChange, 0, 0)) {
-                TRACE("Requesting ASIO buffer size change notification\n");
-                printf("GUI: Requesting ASIO buffer size change notification\n");
-                This->asio_callbacks->asioMessage(kAsioBufferSizeChange, 0, 0, 0);
-            } else {
-                printf("GUI: ASIO callbacks not available or buffer size change not supported\n");
-            }
-        }
+        reconfigure_clock(This, conf->cf_buffer_size, conf->cf_sample_rate);
     } else {
-        printf("GUI: Buffer size unchanged (%u samples)\n", conf->cf_buffer_size);
-    }
-    
-    // Apply sample rate change if different
-    if (This->asio_sample_rate != conf->cf_sample_rate) {
-        TRACE("Changing sample rate from %.0f to %u\n", This->asio_sample_rate, conf->cf_sample_rate);
-        printf("GUI: Changing sample rate from %.0f to %u\n", This->asio_sample_rate, conf->cf_sample_rate);
-        This->asio_sample_rate = conf->cf_sample_rate;
-        
-        // If PipeWire filter is connected, we need to reconnect it with the new sample rate
-        if (This->pw_filter && pw_filter_get_state(This->pw_filter, NULL) != PW_FILTER_STATE_UNCONNECTED) {
-            TRACE("Reconnecting PipeWire filter with new sample rate\n");
-            printf("GUI: Reconnecting PipeWire filter with new sample rate\n");
-            
-            // Disconnect the current filter
-            user_pw_lock_loop(This->pw_helper);
-            pw_filter_disconnect(This->pw_filter);
-            user_pw_unlock_loop(This->pw_helper);
-            
-            // Wait for disconnection
-            user_pw_wait_for_filter_state(This->pw_helper, This->pw_filter, PW_FILTER_STATE_UNCONNECTED, 5000);
-            
-            // Reconnect with new sample rate
-            char pod_buffer[0x1000];
-            struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(pod_buffer, sizeof pod_buffer);
-            struct spa_audio_info_raw format = SPA_AUDIO_INFO_RAW_INIT(
-                .format = SPA_AUDIO_FORMAT_F32,
-                .rate = This->asio_sample_rate,
-                .channels = This->asio_active_outputs,
-            );
-            
-            /* Calculate latency in nanoseconds from current buffer size and new sample rate */
-            uint64_t latency_ns = (uint64_t)This->asio_current_buffersize * SPA_NSEC_PER_SEC / (uint64_t)This->asio_sample_rate;
-            
-            /* Add timing constraints to ensure consistent buffer sizes */
-            struct spa_pod const *connect_params[] = {
-                spa_format_audio_raw_build(&pod_builder, SPA_PARAM_EnumFormat, &format),
-                spa_process_latency_build(&pod_builder, SPA_PARAM_ProcessLatency,
-                    &SPA_PROCESS_LATENCY_INFO_INIT(.ns = latency_ns)),
-                spa_pod_builder_add_object(&pod_builder,
-                    SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
-                    SPA_PARAM_BUFFERS_buffers, SPA_POD_Int(2),
-                    SPA_PARAM_BUFFERS_blocks, SPA_POD_Int(1),
-                    SPA_PARAM_BUFFERS_size, SPA_POD_Int(This->asio_current_buffersize * sizeof(float)),
-                    SPA_PARAM_BUFFERS_stride, SPA_POD_Int(sizeof(float))
-                ),
-            };
-            
-            printf("GUI: Reconnecting PipeWire with new sample rate: %.0f Hz (buffer: %d samples)\n", 
-                   This->asio_sample_rate, This->asio_current_buffersize);
-            
-            user_pw_lock_loop(This->pw_helper);
-            if (pw_filter_connect(This->pw_filter, PW_FILTER_FLAG_RT_PROCESS, connect_params, ARRAYSIZE(connect_params)) < 0) {
-                user_pw_unlock_loop(This->pw_helper);
-                ERR("Failed to reconnect PipeWire filter with new sample rate\n");
-                printf("GUI: ERROR - Failed to reconnect PipeWire filter with new sample rate\n");
-            } else {
-                user_pw_unlock_loop(This->pw_helper);
-                
-                // Wait for filter to reach paused state
-                if (user_pw_wait_for_filter_state(This->pw_helper, This->pw_filter, PW_FILTER_STATE_PAUSED, 10000)) {
-                    TRACE("PipeWire filter successfully reconnected with new sample rate\n");
-                    printf("GUI: PipeWire filter successfully reconnected with new sample rate\n");
-                } else {
-                    ERR("Timeout waiting for PipeWire filter to reach paused state after sample rate change\n");
-                    printf("GUI: ERROR - Timeout waiting for PipeWire filter to reach paused state after sample rate change\n");
-                }
-            }
-        } else {
-            printf("GUI: PipeWire filter not connected, sample rate will be applied on next connection\n");
-        }
-        
-        // If the driver is running, notify the ASIO host about the sample rate change
-        if (This->asio_driver_state == Running && This->asio_callbacks) {
-            if (This->asio_callbacks->asioMessage(kAsioSelectorSupported, kAsioResetRequest, 0, 0)) {
-                TRACE("Requesting ASIO reset due to sample rate change\n");
-                printf("GUI: Requesting ASIO reset due to sample rate change\n");
-                This->asio_callbacks->asioMessage(kAsioResetRequest, 0, 0, 0);
-            }
-        }
+        printf("GUI: Buffer size (%u samples) and sample rate unchanged\n", conf->cf_buffer_size);
     }
     
     // Apply input/output channel changes
@@ -2448,11 +3390,31 @@ static DWORD WINAPI jack_thread_creator_helper(LPVOID arg)
     TRACE("arg: %p\n", arg);
 
     jack_thread_creator_privates.jack_callback_pthread_id = pthread_self();
+    tls_wine_created_thread = true;
     SetEvent(jack_thread_creator_privates.jack_callback_thread_created);
     jack_thread_creator_privates.jack_callback_thread(jack_thread_creator_privates.arg);
     return 0;
 }
 
+/* A device setting is a node.name, or else the object.serial or bound id
+ * that pw-cli and wpctl list. Serials come first: ids are reused. */
+static struct pw_node *find_device_node(IWineASIOImpl *This, char const *name) {
+    struct pw_node *node = user_pw_find_node_by_name(This->pw_helper, name);
+    unsigned long long number;
+    char *end;
+
+    if (node || name[0] < '0' || name[0] > '9')
+        return node;
+    errno = 0;
+    number = strtoull(name, &end, 10);
+    if (*end || errno)
+        return NULL;
+    node = user_pw_find_node_by_serial(This->pw_helper, number);
+    if (!node && number <= UINT32_MAX)
+        node = user_pw_find_node_by_id(This->pw_helper, (uint32_t)number);
+    return node;
+}
+
 static void get_nodes_by_name(IWineASIOImpl *This) {
     char *namebuf = NULL;
     int namebuf_len = 0;
@@ -2475,7 +3437,7 @@ static void get_nodes_by_name(IWineASIOImpl *This) {
                 // Should never happen.
                 abort();
             }
-            This->current_input_node = user_pw_find_node_by_name(This->pw_helper, namebuf);
+            This->current_input_node = find_device_node(This, namebuf);
         }
     }
 
@@ -2493,7 +3455,7 @@ static void get_nodes_by_name(IWineASIOImpl *This) {
                 // Should never happen.
                 abort();
             }
-            This->current_output_node = user_pw_find_node_by_name(This->pw_helper, namebuf);
+            This->current_output_node = find_device_node(This, namebuf);
         }
     }
 
@@ -2537,6 +3499,51 @@ static const WCHAR value_pwasio_connect_to_hardware[] = u"Connect to hardware";
 static const WCHAR value_pwasio_input_device[] = u"Input device";
 static const WCHAR value_pwasio_output_device[] = u"Output device";
 
+/* Settings that configure_driver() reads from the registry, the config files
+ * and the environment. They are read once per process: hosts open and close
+ * the driver all the time (plugin scans, settings dialogs, project loads) and
+ * later instances start from this copy. store_config() refreshes it. */
+#define DRIVER_CONFIG_FIELDS(X) \
+    X(wineasio_number_inputs) \
+    X(wineasio_number_outputs) \
+    X(wineasio_autostart_server) \
+    X(wineasio_connect_to_hardware) \
+    X(wineasio_fixed_buffersize) \
+    X(wineasio_preferred_buffersize) \
+    X(asio_current_buffersize) \
+    X(asio_sample_rate) \
+    X(pwasio_input_device_name) \
+    X(pwasio_output_device_name) \
+    X(pwasio_callback_wakeup) \
+    X(pwasio_callback_spin_us) \
+    X(pwasio_direct_dispatch) \
+    X(pwasio_zero_copy) \
+    X(pwasio_hugepages) \
+    X(pwasio_stats) \
+    X(pwasio_late_policy) \
+    X(pwasio_force_graph_clock) \
+    X(pwasio_interleaved_ports) \
+    X(pwasio_input_format) \
+    X(pwasio_output_format) \
+    X(client_name)
+
+static pthread_mutex_t cached_config_mutex = PTHREAD_MUTEX_INITIALIZER;
+static IWineASIOImpl   cached_config;
+static bool            cached_config_valid;
+
+static void copy_driver_config(IWineASIOImpl *dst, IWineASIOImpl const *src) {
+#define COPY_CONFIG_FIELD(field) memcpy(&dst->field, &src->field, sizeof dst->field);
+    DRIVER_CONFIG_FIELDS(COPY_CONFIG_FIELD)
+#undef COPY_CONFIG_FIELD
+}
+
+static void remember_driver_config(IWineASIOImpl *This) {
+    pthread_mutex_lock(&cached_config_mutex);
+    copy_driver_config(&cached_config, This);
+    cached_config_valid = true;
+    pthread_mutex_unlock(&cached_config_mutex);
+}
+
 static void store_config(IWineASIOImpl *This) {
     HKEY  hkey;
     LONG  result;
@@ -2554,6 +3561,16 @@ static void store_config(IWineASIOImpl *This) {
     result = RegSetValueExW(hkey, value_pwasio_connect_to_hardware, 0, REG_DWORD, (LPBYTE) &bool_value, sizeof(bool_value));
     result = RegSetValueExW(hkey, value_pwasio_input_device, 0, REG_SZ, (LPBYTE) &This->pwasio_input_device_name, sizeof(This->pwasio_input_device_name));
     result = RegSetValueExW(hkey, value_pwasio_output_device, 0, REG_SZ, (LPBYTE) &This->pwasio_output_device_name, sizeof(This->pwasio_output_device_name));
+
+    remember_driver_config(This);
+}
+
+/* Called from DllMain when the DLL is unloaded while the process keeps
+ * running; the shared PipeWire connection must not outlive our code */
+void WineASIOUnload(void)
+{
+    user_pw_shutdown_shared_helper();
+    pw_asio_log_stop();
 }
 
 /* Allocate the interface pointer and associate it with the vtbl/WineASIO object */
@@ -2563,7 +3580,7 @@ HRESULT WINAPI WineASIOCreateInstance(REFIID riid, LPVOID *ppobj, IUnknown *cls_
 
     /* TRACE("riid: %s, ppobj: %p\n", debugstr_guid(riid), ppobj); */
 
-    pobj = HeapAlloc(GetProcessHeap(), 0, sizeof(*pobj));
+    pobj = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*pobj));
     if (pobj == NULL)
     {
         WARN("out of memory\n");
@@ -2582,27 +3599,45 @@ HRESULT WINAPI WineASIOCreateInstance(REFIID riid, LPVOID *ppobj, IUnknown *cls_
 
 static VOID configure_driver(IWineASIOImpl *This)
 {
-    HKEY    hkey;
-    LONG    result, value;
-    LSTATUS status;
-    DWORD   type, size;
-    WCHAR   application_path [MAX_PATH];
-    WCHAR   *application_name;
-    char    environment_variable[MAX_ENVIRONMENT_SIZE];
-
     /* Initialise most member variables,
      * asio_sample_position, asio_time, & asio_time_stamp are initialized in Start()
      * jack_num_input_ports & jack_num_output_ports are initialized in Init() */
     This->asio_active_inputs = 0;
     This->asio_active_outputs = 0;
-    This->asio_buffer_index = 0;
     This->asio_callbacks = NULL;
     This->asio_can_time_code = FALSE;
     This->asio_driver_state = Loaded;
-    This->asio_sample_rate = 48000; /* Default to 48kHz sample rate */
     This->asio_time_info_mode = FALSE;
     This->asio_version = 10;
 
+    //This->callback_audio_buffer = NULL;
+    This->input_channel = NULL;
+    This->output_channel = NULL;
+
+    pthread_mutex_lock(&cached_config_mutex);
+    if (cached_config_valid) {
+        copy_driver_config(This, &cached_config);
+        pthread_mutex_unlock(&cached_config_mutex);
+        printf("Using cached driver configuration (buffer size %d)\n", This->asio_current_buffersize);
+        return;
+    }
+    read_driver_config(This);
+    copy_driver_config(&cached_config, This);
+    cached_config_valid = true;
+    pthread_mutex_unlock(&cached_config_mutex);
+}
+
+static VOID read_driver_config(IWineASIOImpl *This)
+{
+    HKEY    hkey;
+    LONG    result, value;
+    LSTATUS status;
+    DWORD   type, size;
+    WCHAR   application_path [MAX_PATH];
+    WCHAR   *application_name;
+    char    environment_variable[MAX_ENVIRONMENT_SIZE];
+
+    This->asio_sample_rate = 48000; /* Default to 48kHz sample rate */
     This->wineasio_number_inputs = 16;
     This->wineasio_number_outputs = 16;
     This->wineasio_autostart_server = FALSE;
@@ -2610,13 +3645,21 @@ static VOID configure_driver(IWineASIOImpl *This)
     This->wineasio_fixed_buffersize = TRUE;  /* Force fixed buffer size for stable timing */
     This->wineasio_preferred_buffersize = ASIO_PREFERRED_BUFFERSIZE;
     This->asio_current_buffersize = This->wineasio_preferred_buffersize;
+    This->pwasio_callback_wakeup = PW_HANDOFF_WAKEUP_EVENT;
+    This->pwasio_callback_spin_us = PW_HANDOFF_DEFAULT_SPIN_US;
+    This->pwasio_direct_dispatch = FALSE;
+    This->pwasio_zero_copy = FALSE;
+    This->pwasio_hugepages = FALSE;
+    This->pwasio_stats = TRUE;
+    This->pwasio_late_policy = PW_CYCLE_LATE_SILENCE;
+    This->pwasio_force_graph_clock = TRUE;
+    This->pwasio_interleaved_ports = FALSE;
+    This->pwasio_input_format = PW_SAMPLE_FLOAT32;
+    This->pwasio_output_format = PW_SAMPLE_FLOAT32;
     
     printf("DEBUG: Initial buffer size set to %d (from ASIO_PREFERRED_BUFFERSIZE)\n", This->asio_current_buffersize);
 
     This->client_name[0] = 0;
-    //This->callback_audio_buffer = NULL;
-    This->input_channel = NULL;
-    This->output_channel = NULL;
 
     /* create registry entries with defaults if not present */
     result = RegCreateKeyExW(HKEY_CURRENT_USER, key_software_wine_pwasio, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL);
@@ -2816,6 +3859,49 @@ static VOID configure_driver(IWineASIOImpl *This)
             TRACE("Loaded auto-connect from config: %s\n", config_args.auto_connect ? "true" : "false");
             printf("Loaded auto-connect from config: %s\n", config_args.auto_connect ? "true" : "false");
             
+            if (config_args.callback_wakeup >= 0 && config_args.callback_wakeup < PW_HANDOFF_WAKEUP_COUNT) {
+                This->pwasio_callback_wakeup = config_args.callback_wakeup;
+                This->pwasio_callback_spin_us = config_args.callback_spin_us;
+                printf("Loaded callback wakeup from config: %s (spin %u us)\n",
+                       pw_handoff_wakeup_name(This->pwasio_callback_wakeup), This->pwasio_callback_spin_us);
+            }
+            
+            This->pwasio_direct_dispatch = config_args.direct_dispatch;
+            printf("Loaded direct dispatch from config: %s\n", config_args.direct_dispatch ? "true" : "false");
+
+            This->pwasio_zero_copy = config_args.zero_copy;
+            printf("Loaded zero copy from config: %s\n", config_args.zero_copy ? "true" : "false");
+
+            This->pwasio_hugepages = config_args.hugepages;
+            printf("Loaded huge pages from config: %s\n", config_args.hugepages ? "true" : "false");
+
+            This->pwasio_stats = config_args.stats;
+            printf("Loaded stats from config: %s\n", config_args.stats ? "true" : "false");
+
+            if (config_args.late_policy >= 0 && config_args.late_policy < PW_CYCLE_LATE_COUNT) {
+                This->pwasio_late_policy = config_args.late_policy;
+                printf("Loaded late policy from config: %s\n", pw_cycle_late_policy_name(This->pwasio_late_policy));
+            }
+
+            This->pwasio_force_graph_clock = config_args.force_graph_clock;
+            printf("Loaded force graph clock from config: %s\n", config_args.force_graph_clock ? "true" : "false");
+
+            This->pwasio_interleaved_ports = config_args.interleaved_ports;
+            printf("Loaded interleaved ports from config: %s\n", config_args.interleaved_ports ? "true" : "false");
+
+            if (config_args.input_format >= 0 && config_args.input_format < PW_SAMPLE_FORMAT_COUNT) {
+                This->pwasio_input_format = config_args.input_format;
+                printf("Loaded input format from config: %s\n", pw_sample_format_name(This->pwasio_input_format));
+            }
+            if (config_args.output_format >= 0 && config_args.output_format < PW_SAMPLE_FORMAT_COUNT) {
+                This->pwasio_output_format = config_args.output_format;
+                printf("Loaded output format from config: %s\n", pw_sample_format_name(This->pwasio_output_format));
+            }
+
+            pw_asio_set_log_level(config_args.debug_logging && config_args.log_level < PW_ASIO_LOG_DEBUG
+                                  ? PW_ASIO_LOG_DEBUG : config_args.log_level);
+            printf("Loaded log level from config: %d\n", pw_asio_get_log_level());
+            
             printf("Loaded configuration from: %s\n", config_paths[i]);
             break;
         }
@@ -2824,6 +3910,11 @@ static VOID configure_driver(IWineASIOImpl *This)
     if (!config_loaded) {
         TRACE("No configuration file found, using registry/defaults\n");
         printf("No configuration file found, using registry/defaults\n");
+
+        /* PIPEWIREASIO_LOG_LEVEL still applies */
+        pw_asio_init_default_config(&config_args);
+        pw_asio_apply_env_overrides(&config_args);
+        pw_asio_set_log_level(config_args.log_level);
     }
 
     /* Look for environment variables to override registry config values */
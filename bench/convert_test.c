@@ -0,0 +1,111 @@
+/*
+ * Checks that every instruction set's conversion kernels (pw_convert.c) give
+ * the same samples as the scalar ones, bit for bit.
+ *
+ * The input is a ramp over the whole F32 range, values beyond it, and values
+ * that land exactly halfway between two integers of each format, where the
+ * rounding of the scalar code and the SIMD conversion would otherwise part.
+ * The sample counts are chosen so that the SIMD kernels also run their tails.
+ *
+ * Exits non-zero on the first mismatch. Instruction sets this CPU lacks are
+ * skipped.
+ *
+ * Usage: convert_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pw_convert.h"
+
+#define N_SAMPLES 1027
+
+static float const scales[PW_SAMPLE_FORMAT_COUNT] = {
+    [PW_SAMPLE_INT16] = 32768.0f,
+    [PW_SAMPLE_INT24] = 8388608.0f,
+    [PW_SAMPLE_INT32] = 2147483648.0f,
+};
+
+/* Ties of `format` near zero, near full scale and in between, both signs.
+ * Integers up to 2^22 still leave room for the half in a float's mantissa. */
+static void fill_ties(float *dst, uint32_t n, float scale) {
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx) {
+        int32_t k = (int32_t)(idx / 2) * 4099 % (scale < 65536.0f ? 32767 : 4194303);
+        float tie = ((float)k + 0.5f) / scale;
+
+        dst[idx] = idx & 1 ? -tie : tie;
+    }
+}
+
+static void fill_ramp(float *dst, uint32_t n) {
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        dst[idx] = -1.25f + 2.5f * (float)idx / (float)(n - 1);
+}
+
+/* Converts `src` both ways with `isa` and compares with the scalar kernels */
+static int check(struct pw_convert const *ref, struct pw_convert const *conv, enum pw_sample_format format,
+                 float const *src, char const *what) {
+    static uint8_t want[N_SAMPLES * 8], got[N_SAMPLES * 8];
+    static float want_back[N_SAMPLES], got_back[N_SAMPLES];
+    size_t size = (size_t)N_SAMPLES * pw_sample_format_size(format);
+    uint32_t n;
+
+    /* Every length up to two AVX-512 vectors, then the whole buffer */
+    for (n = 1; n <= N_SAMPLES; n = n < 32 ? n + 1 : N_SAMPLES) {
+        memset(want, 0, size);
+        memset(got, 0, size);
+        ref->to_host[format](want, src, n);
+        conv->to_host[format](got, src, n);
+        if (memcmp(want, got, size)) {
+            fprintf(stderr, "%s: F32 to %s differs from scalar on %s, %u samples\n",
+                    pw_convert_isa_name(conv->isa), pw_sample_format_name(format), what, n);
+            return -1;
+        }
+
+        ref->from_host[format](want_back, want, n);
+        conv->from_host[format](got_back, want, n);
+        if (memcmp(want_back, got_back, n * sizeof(float))) {
+            fprintf(stderr, "%s: %s to F32 differs from scalar on %s, %u samples\n",
+                    pw_convert_isa_name(conv->isa), pw_sample_format_name(format), what, n);
+            return -1;
+        }
+
+        if (n == N_SAMPLES)
+            break;
+    }
+    return 0;
+}
+
+int main(void) {
+    static float ramp[N_SAMPLES], ties[N_SAMPLES];
+    struct pw_convert const *ref = pw_convert_for_isa(PW_CONVERT_SCALAR);
+    int isa, format;
+
+    fill_ramp(ramp, N_SAMPLES);
+
+    for (isa = PW_CONVERT_SCALAR + 1; isa < PW_CONVERT_ISA_COUNT; ++isa) {
+        struct pw_convert const *conv = pw_convert_for_isa((enum pw_convert_isa)isa);
+
+        if (!conv) {
+            printf("%-8s skipped, not available\n", pw_convert_isa_name((enum pw_convert_isa)isa));
+            continue;
+        }
+
+        for (format = 0; format < PW_SAMPLE_FORMAT_COUNT; ++format) {
+            if (check(ref, conv, (enum pw_sample_format)format, ramp, "ramp"))
+                return EXIT_FAILURE;
+            if (!scales[format])
+                continue;
+            fill_ties(ties, N_SAMPLES, scales[format]);
+            if (check(ref, conv, (enum pw_sample_format)format, ties, "ties"))
+                return EXIT_FAILURE;
+        }
+        printf("%-8s ok\n", pw_convert_isa_name((enum pw_convert_isa)isa));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,348 @@
+/*
+ * Cost of the per-cycle copy/dispatch work (pw_cycle.c) without PipeWire or
+ * Wine.
+ *
+ * Every channel gets a fake port with two buffers that alternate from cycle
+ * to cycle like a PipeWire buffer queue, and the host buffers are laid out in
+ * a pw_arena the way CreateBuffers() does it. The graph clock is synthetic:
+ * the position advances by one quantum per cycle. The host does nothing
+ * unless -p is given, in which case it copies every input to the matching
+ * output, so by default only the driver's own work is measured.
+ *
+ * For each channel count and buffer size this prints the mean time per graph
+ * cycle, the time per sample (one frame of one port, inputs and outputs both
+ * count), the share of the period at 48 kHz, and the hardware cache misses
+ * per cycle when perf counters are available.
+ *
+ * Modes:
+ *   copy      quantum == buffer size, host buffers separate from the ports
+ *   zerocopy  as copy, but the outputs hand the port buffers to the host
+ *   adapter   quantum is 3/4 of the buffer size, going through the rings
+ *   interleaved  as copy, but one interleaved port per direction
+ *
+ * -t gives the host's sample format in both directions (default float32) and
+ * -i the instruction set of the conversion kernels (default the best one).
+ *
+ * Usage: cycle_bench [-m copy|zerocopy|adapter|interleaved] [-c channels] [-f frames] [-n samples] [-p]
+ *                    [-t float32|int16|int24|int32|float64] [-i scalar|sse2|avx2|avx512]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "pw_arena.h"
+#include "pw_cycle.h"
+
+#define CACHE_LINE_SIZE 64
+#define ALIGN_TO_CACHE_LINE(size) (((size) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1))
+
+enum mode { MODE_COPY, MODE_ZEROCOPY, MODE_ADAPTER, MODE_INTERLEAVED };
+
+static char const *const mode_names[] = { "copy", "zerocopy", "adapter", "interleaved" };
+
+struct fake_port {
+    float *buffers[2];
+    int next;
+};
+
+struct bench {
+    struct pw_cycle cycle;
+    IOChannel *channels;
+    struct pw_cycle_route *routes;
+    float **planes;
+    struct fake_port *ports;
+    float *port_data;
+    float *ring_data;
+    struct pw_arena arena;
+    int n_channels;
+    bool passthrough;
+    size_t sample_size;
+    volatile uint64_t switches;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *fake_get_buffer(void *data, void *port, uint32_t n_samples) {
+    struct fake_port *p = port;
+    float *buffer = p->buffers[p->next];
+
+    (void)data;
+    (void)n_samples;
+    p->next ^= 1;
+    return buffer;
+}
+
+static bool fake_buffer_switch(void *data, int buffer_index, uint64_t time_ns, bool freewheel) {
+    struct bench *b = data;
+
+    (void)time_ns;
+    (void)freewheel;
+    b->switches++;
+    if (!b->passthrough)
+        return true;
+    for (int idx = 0; idx < b->n_channels; ++idx)
+        memcpy(b->cycle.outputs[idx].host_buffers[buffer_index], b->cycle.inputs[idx].host_buffers[buffer_index],
+               b->cycle.block * b->sample_size);
+    return true;
+}
+
+static void fake_buffer_skipped(void *data, uint64_t time_ns) {
+    (void)data;
+    (void)time_ns;
+}
+
+static struct pw_cycle_ops const fake_ops = {
+    .get_buffer = fake_get_buffer,
+    .buffer_switch = fake_buffer_switch,
+    .buffer_skipped = fake_buffer_skipped,
+};
+
+/* Hardware cache misses of this thread, or -1 when perf is not available */
+static int perf_open(char *why, size_t why_size) {
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof attr,
+        .config = PERF_COUNT_HW_CACHE_MISSES,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0)
+        snprintf(why, why_size, "%s", strerror(errno));
+    return fd;
+}
+
+static void bench_clear(struct bench *b) {
+    pw_arena_clear(&b->arena);
+    free(b->channels);
+    free(b->routes);
+    free(b->planes);
+    free(b->ports);
+    free(b->port_data);
+    free(b->ring_data);
+    memset(b, 0, sizeof *b);
+}
+
+static int bench_init(struct bench *b, enum mode mode, int n_channels, uint32_t frames, bool passthrough,
+                      enum pw_sample_format format, struct pw_convert const *convert) {
+    size_t sample_size = pw_sample_format_size(format);
+    size_t stride = ALIGN_TO_CACHE_LINE(frames * sample_size);
+    size_t port_stride = ALIGN_TO_CACHE_LINE(PW_BLOCK_ADAPTER_MAX_QUANTUM * sizeof(float));
+    uint32_t ring_capacity = pw_block_adapter_capacity(frames);
+    int n_ports = 2 * n_channels;
+    int n_copying = mode == MODE_ZEROCOPY ? n_channels : n_ports;
+    int slot = 0;
+
+    memset(b, 0, sizeof *b);
+    b->n_channels = n_channels;
+    b->passthrough = passthrough;
+    b->sample_size = sample_size;
+    b->channels = calloc(n_ports, sizeof *b->channels);
+    b->routes = calloc(2 * n_ports, sizeof *b->routes);
+    b->planes = calloc(n_ports, sizeof *b->planes);
+    b->ports = calloc(n_ports, sizeof *b->ports);
+    b->port_data = aligned_alloc(CACHE_LINE_SIZE, 2 * n_ports * port_stride);
+    b->ring_data = aligned_alloc(CACHE_LINE_SIZE, (size_t)n_ports * ring_capacity * sizeof(float));
+    if (!b->channels || !b->routes || !b->planes || !b->ports || !b->port_data || !b->ring_data ||
+        pw_arena_init(&b->arena, 2 * n_copying * stride, false) < 0) {
+        bench_clear(b);
+        return -ENOMEM;
+    }
+    memset(b->port_data, 0, 2 * n_ports * port_stride);
+
+    for (int idx = 0; idx < n_ports; ++idx) {
+        IOChannel *chan = &b->channels[idx];
+        struct fake_port *port = &b->ports[idx];
+        bool output = idx >= n_channels;
+
+        port->buffers[0] = (float *)((char *)b->port_data + (2 * idx) * port_stride);
+        port->buffers[1] = (float *)((char *)b->port_data + (2 * idx + 1) * port_stride);
+        /* Something for the inputs to carry */
+        for (uint32_t frame = 0; frame < frames; ++frame)
+            port->buffers[0][frame] = port->buffers[1][frame] = (float)frame / frames;
+
+        chan->active = true;
+        chan->port = port;
+        chan->buffer_size = frames * sample_size;
+        chan->needs_copy = !(output && mode == MODE_ZEROCOPY);
+        if (chan->needs_copy) {
+            for (int half = 0; half < 2; ++half)
+                chan->host_buffers[half] = (char *)b->arena.base + (half * n_copying + slot) * stride;
+            ++slot;
+        } else {
+            chan->host_buffers[0] = port->buffers[0];
+            chan->host_buffers[1] = port->buffers[1];
+        }
+        chan->ring_data = b->ring_data + (size_t)idx * ring_capacity;
+        pw_ring_init(&chan->ring, chan->ring_data, ring_capacity);
+    }
+
+    b->cycle.ops = &fake_ops;
+    b->cycle.data = b;
+    b->cycle.inputs = b->channels;
+    b->cycle.outputs = b->channels + n_channels;
+    b->cycle.n_inputs = n_channels;
+    b->cycle.n_outputs = n_channels;
+    b->cycle.routes = b->routes;
+    b->cycle.input_planes = b->planes;
+    b->cycle.output_planes = (float const **)(b->planes + n_channels);
+    b->cycle.input_format = b->cycle.output_format = format;
+    b->cycle.convert = convert;
+    if (mode == MODE_INTERLEAVED) {
+        /* The same port memory, as one port of n_channels per direction */
+        for (int idx = 0; idx < 2; ++idx) {
+            struct fake_port *port = &b->ports[idx];
+            port->buffers[0] = (float *)((char *)b->port_data + (2 * idx) * n_channels * port_stride);
+            port->buffers[1] = (float *)((char *)b->port_data + (2 * idx + 1) * n_channels * port_stride);
+            port->next = 0;
+        }
+        for (int idx = 0; idx < n_ports; ++idx)
+            b->channels[idx].port = NULL;
+        b->cycle.interleaved = true;
+        b->cycle.interleaved_inputs = &b->ports[0];
+        b->cycle.interleaved_outputs = &b->ports[1];
+    }
+    pw_cycle_build_plan(&b->cycle, frames);
+    pw_cycle_reset(&b->cycle, frames, 48000.0);
+    return 0;
+}
+
+static int run_one(enum mode mode, int n_channels, uint32_t frames, uint64_t target_samples,
+                   bool passthrough, enum pw_sample_format format, struct pw_convert const *convert, int perf_fd) {
+    struct bench b;
+    uint32_t quantum = mode == MODE_ADAPTER ? frames * 3 / 4 : frames;
+    uint64_t cycles = target_samples / ((uint64_t)quantum * n_channels);
+    uint64_t nsec = 0, period_ns = (uint64_t)quantum * 1000000000ULL / 48000;
+    uint64_t start, elapsed, misses = 0;
+    double ns_per_cycle;
+    int res;
+
+    if (!quantum)
+        return 0;
+    if ((res = bench_init(&b, mode, n_channels, frames, passthrough, format, convert)) < 0) {
+        fprintf(stderr, "%d channels x %u frames: %s\n", n_channels, frames, strerror(-res));
+        return res;
+    }
+    if (cycles < 16)
+        cycles = 16;
+
+    /* Warm up: fault everything in and let the adapter reach steady state */
+    for (int idx = 0; idx < 8; ++idx, nsec += period_ns)
+        pw_cycle_process(&b.cycle, quantum, nsec, false);
+
+    if (perf_fd >= 0) {
+        ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    start = now_ns();
+    for (uint64_t idx = 0; idx < cycles; ++idx, nsec += period_ns)
+        pw_cycle_process(&b.cycle, quantum, nsec, false);
+    elapsed = now_ns() - start;
+    if (perf_fd >= 0) {
+        ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf_fd, &misses, sizeof misses) != sizeof misses)
+            misses = 0;
+    }
+
+    ns_per_cycle = (double)elapsed / cycles;
+    printf("%8d %8u %8u %10llu %12.0f %10.3f %8.2f",
+           n_channels, frames, quantum, (unsigned long long)cycles, ns_per_cycle,
+           ns_per_cycle / ((double)quantum * 2 * n_channels),
+           100.0 * ns_per_cycle / period_ns);
+    if (perf_fd >= 0)
+        printf(" %12.0f", (double)misses / cycles);
+    else
+        printf(" %12s", "-");
+    if (b.cycle.adapter_underruns)
+        printf("  UNDERRUNS %u", b.cycle.adapter_underruns);
+    putchar('\n');
+
+    bench_clear(&b);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    enum mode mode = MODE_COPY;
+    int only_channels = 0;
+    uint32_t only_frames = 0;
+    uint64_t target_samples = 1 << 24;
+    bool passthrough = false;
+    enum pw_sample_format format = PW_SAMPLE_FLOAT32;
+    struct pw_convert const *convert = pw_convert_best();
+    char why[128] = "";
+    int perf_fd;
+    int opt, value;
+
+    while ((opt = getopt(argc, argv, "m:c:f:n:pt:i:")) != -1) {
+        switch (opt) {
+            case 'm':
+                for (mode = 0; mode <= MODE_INTERLEAVED && strcmp(optarg, mode_names[mode]); ++mode) {}
+                if (mode > MODE_INTERLEAVED) {
+                    fprintf(stderr, "unknown mode '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'c': only_channels = atoi(optarg); break;
+            case 'f': only_frames = strtoul(optarg, NULL, 0); break;
+            case 'n': target_samples = strtoull(optarg, NULL, 0); break;
+            case 'p': passthrough = true; break;
+            case 't':
+                if ((value = pw_sample_format_from_string(optarg)) < 0) {
+                    fprintf(stderr, "unknown sample format '%s'\n", optarg);
+                    return 2;
+                }
+                format = value;
+                break;
+            case 'i':
+                if ((value = pw_convert_isa_from_string(optarg)) < 0 || !(convert = pw_convert_for_isa(value))) {
+                    fprintf(stderr, "instruction set '%s' not available\n", optarg);
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-m copy|zerocopy|adapter|interleaved] [-c channels] [-f frames] [-n samples] [-p]\n"
+                                "       [-t float32|int16|int24|int32|float64] [-i scalar|sse2|avx2|avx512]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (mode == MODE_ZEROCOPY && format != PW_SAMPLE_FLOAT32) {
+        fprintf(stderr, "zerocopy needs float32 host buffers\n");
+        return 2;
+    }
+    if (only_channels < 0 || only_frames > PW_BLOCK_ADAPTER_MAX_QUANTUM) {
+        fprintf(stderr, "frames must be at most %u\n", PW_BLOCK_ADAPTER_MAX_QUANTUM);
+        return 2;
+    }
+
+    perf_fd = perf_open(why, sizeof why);
+    printf("%s mode, %s host, %s samples (%s), %llu samples per point%s%s%s\n", mode_names[mode],
+           passthrough ? "passthrough" : "null", pw_sample_format_name(format), pw_convert_isa_name(convert->isa),
+           (unsigned long long)target_samples,
+           perf_fd < 0 ? " (cache misses unavailable: " : "", why, perf_fd < 0 ? ")" : "");
+    printf("%8s %8s %8s %10s %12s %10s %8s %12s\n",
+           "channels", "frames", "quantum", "cycles", "ns/cycle", "ns/sample", "load%", "misses/cycle");
+
+    for (int n_channels = only_channels ? only_channels : 2; n_channels <= (only_channels ? only_channels : 256); n_channels *= 2) {
+        for (uint32_t frames = only_frames ? only_frames : 16;
+             frames <= (only_frames ? only_frames : PW_BLOCK_ADAPTER_MAX_QUANTUM); frames *= 2) {
+            if (run_one(mode, n_channels, frames, target_samples, passthrough, format, convert, perf_fd) < 0)
+                return 1;
+        }
+    }
+
+    if (perf_fd >= 0)
+        close(perf_fd);
+    return 0;
+}
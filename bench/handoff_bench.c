@@ -0,0 +1,248 @@
+/*
+ * Wake-to-run latency of the callback handoff backends.
+ *
+ * A producer thread stands in for the PipeWire data thread and posts one
+ * request per simulated period; a consumer thread stands in for the Wine
+ * thread running bufferSwitch. For every request we record the time from
+ * posting to the consumer running, and the full round trip until the producer
+ * sees the completion.
+ *
+ * The "event" backend is emulated with a pthread auto-reset event here; under
+ * Wine it goes through the wineserver (or esync/fsync) and is slower.
+ *
+ * Usage: handoff_bench [-n iterations] [-p period_us] [-s spin_us] [-b backend]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pw_handoff.h"
+
+struct bench {
+    struct pw_handoff handoff;
+    int iterations;
+    volatile int stop;
+    uint64_t posted_ns;
+    uint64_t *wake_ns;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline) {
+    struct timespec ts = {
+        .tv_sec = deadline / 1000000000ULL,
+        .tv_nsec = deadline % 1000000000ULL,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static void set_thread_rt(int cpu) {
+    struct sched_param param = { .sched_priority = 80 };
+    cpu_set_t set;
+
+    /* Best effort: without rtkit/limits this just keeps SCHED_OTHER */
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (cpu >= 0 && cpu < sysconf(_SC_NPROCESSORS_ONLN)) {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+    }
+}
+
+/* Auto-reset event emulation for PW_HANDOFF_WAKEUP_EVENT */
+struct emu_event {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int signalled;
+};
+
+static void *emu_event_create(void) {
+    struct emu_event *ev = calloc(1, sizeof *ev);
+    pthread_condattr_t attr;
+    if (!ev)
+        return NULL;
+    pthread_mutex_init(&ev->mutex, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ev->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return ev;
+}
+
+static void emu_event_signal(void *event) {
+    struct emu_event *ev = event;
+    pthread_mutex_lock(&ev->mutex);
+    ev->signalled = 1;
+    pthread_cond_signal(&ev->cond);
+    pthread_mutex_unlock(&ev->mutex);
+}
+
+static int emu_event_wait(void *event, int timeout_ms) {
+    struct emu_event *ev = event;
+    struct timespec ts;
+    int res = 0;
+
+    if (timeout_ms >= 0) {
+        uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+        ts.tv_sec = deadline / 1000000000ULL;
+        ts.tv_nsec = deadline % 1000000000ULL;
+    }
+    pthread_mutex_lock(&ev->mutex);
+    while (!ev->signalled && res == 0)
+        res = timeout_ms < 0 ? pthread_cond_wait(&ev->cond, &ev->mutex)
+                             : pthread_cond_timedwait(&ev->cond, &ev->mutex, &ts);
+    if (ev->signalled) {
+        ev->signalled = 0;
+        res = 0;
+    }
+    pthread_mutex_unlock(&ev->mutex);
+    return res == ETIMEDOUT ? 1 : res ? -1 : 0;
+}
+
+static void emu_event_destroy(void *event) {
+    struct emu_event *ev = event;
+    pthread_cond_destroy(&ev->cond);
+    pthread_mutex_destroy(&ev->mutex);
+    free(ev);
+}
+
+static struct pw_handoff_event_ops const emu_event_ops = {
+    .create = emu_event_create,
+    .signal = emu_event_signal,
+    .wait = emu_event_wait,
+    .destroy = emu_event_destroy,
+};
+
+static void *consumer_thread(void *arg) {
+    struct bench *b = arg;
+    uint32_t ticket = 0;
+
+    set_thread_rt(1);
+    while (!b->stop) {
+        if (pw_handoff_wait_request(&b->handoff, &ticket, 100))
+            continue;
+        if (b->stop)
+            break;
+        if (ticket <= (uint32_t)b->iterations)
+            b->wake_ns[ticket - 1] = now_ns() - b->posted_ns;
+        pw_handoff_complete(&b->handoff, ticket);
+    }
+    return NULL;
+}
+
+static int cmp_u64(void const *a, void const *b) {
+    uint64_t x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(char const *what, uint64_t *samples, int count) {
+    double sum = 0;
+    qsort(samples, count, sizeof *samples, cmp_u64);
+    for (int idx = 0; idx < count; ++idx)
+        sum += samples[idx];
+    printf("  %-12s avg %8.0f  p50 %8llu  p90 %8llu  p99 %8llu  p99.9 %8llu  max %8llu ns\n",
+           what, sum / count,
+           (unsigned long long)samples[count / 2],
+           (unsigned long long)samples[(int)(count * 0.90)],
+           (unsigned long long)samples[(int)(count * 0.99)],
+           (unsigned long long)samples[(int)(count * 0.999)],
+           (unsigned long long)samples[count - 1]);
+}
+
+static int run_backend(enum pw_handoff_wakeup wakeup, int iterations, int period_us, int spin_us) {
+    struct bench b = { .iterations = iterations };
+    uint64_t *round_ns;
+    uint64_t next;
+    pthread_t consumer;
+    int timeouts = 0;
+    int res;
+
+    if ((res = pw_handoff_init(&b.handoff, wakeup, spin_us, &emu_event_ops)) < 0) {
+        fprintf(stderr, "%s: init failed: %s\n", pw_handoff_wakeup_name(wakeup), strerror(-res));
+        return -1;
+    }
+    b.wake_ns = calloc(iterations, sizeof *b.wake_ns);
+    round_ns = calloc(iterations, sizeof *round_ns);
+    if (!b.wake_ns || !round_ns) {
+        fputs("out of memory\n", stderr);
+        return -1;
+    }
+
+    pthread_create(&consumer, NULL, consumer_thread, &b);
+    set_thread_rt(0);
+
+    next = now_ns() + 10000000ULL;
+    for (int idx = 0; idx < iterations; ++idx) {
+        uint32_t ticket;
+        sleep_until(next);
+        next += (uint64_t)period_us * 1000ULL;
+
+        b.posted_ns = now_ns();
+        ticket = pw_handoff_post(&b.handoff);
+        if (pw_handoff_wait_done(&b.handoff, ticket, 100))
+            ++timeouts;
+        round_ns[idx] = now_ns() - b.posted_ns;
+    }
+
+    b.stop = 1;
+    pw_handoff_post(&b.handoff);
+    pthread_join(consumer, NULL);
+
+    printf("%s%s (%d iterations, period %d us%s):\n",
+           pw_handoff_wakeup_name(wakeup), wakeup == PW_HANDOFF_WAKEUP_EVENT ? " (pthread emulation)" : "",
+           iterations, period_us, timeouts ? ", TIMEOUTS" : "");
+    report("wake-to-run", b.wake_ns, iterations);
+    report("round trip", round_ns, iterations);
+
+    free(round_ns);
+    free(b.wake_ns);
+    pw_handoff_clear(&b.handoff);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int iterations = 5000;
+    int period_us = 500;
+    int spin_us = PW_HANDOFF_DEFAULT_SPIN_US;
+    int only = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:s:b:")) != -1) {
+        switch (opt) {
+            case 'n': iterations = atoi(optarg); break;
+            case 'p': period_us = atoi(optarg); break;
+            case 's': spin_us = atoi(optarg); break;
+            case 'b':
+                if ((only = pw_handoff_wakeup_from_string(optarg)) < 0) {
+                    fprintf(stderr, "unknown backend '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-p period_us] [-s spin_us] [-b event|futex|eventfd|spin]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (iterations < 1 || period_us < 1) {
+        fputs("iterations and period must be positive\n", stderr);
+        return 2;
+    }
+
+    for (int wakeup = 0; wakeup < PW_HANDOFF_WAKEUP_COUNT; ++wakeup) {
+        if (only >= 0 && wakeup != only)
+            continue;
+        if (run_backend(wakeup, iterations, period_us, spin_us) < 0)
+            return 1;
+    }
+    return 0;
+}
@@ -39,6 +39,7 @@ typedef struct {
 } IClassFactoryImpl;
 
 extern HRESULT WINAPI WineASIOCreateInstance(REFIID riid, LPVOID *ppobj, IUnknown *cls_factory);
+extern void WineASIOUnload(void);
 
 /*******************************************************************************
  * ClassFactory
@@ -179,6 +180,9 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID lpvReserved)
         break;
     case DLL_PROCESS_DETACH:
 /*        TRACE("DLL_PROCESS_DETACH\n"); */
+        /* lpvReserved is NULL for FreeLibrary, non-NULL at process exit */
+        if (!lpvReserved)
+            WineASIOUnload();
         break;
     case DLL_THREAD_ATTACH:
 /*        TRACE("DLL_THREAD_ATTACH\n"); */
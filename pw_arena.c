@@ -0,0 +1,64 @@
+#include "pw_arena.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define PW_ARENA_HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+int pw_arena_init(struct pw_arena *arena, size_t size, bool try_huge) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    void *base = MAP_FAILED;
+
+    memset(arena, 0, sizeof *arena);
+    if (!size)
+        return -EINVAL;
+
+#ifdef MAP_HUGETLB
+    if (try_huge) {
+        size_t huge_size = round_up(size, PW_ARENA_HUGE_PAGE_SIZE);
+        base = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (base != MAP_FAILED) {
+            arena->size = huge_size;
+            arena->huge = true;
+        }
+    }
+#endif
+
+    if (base == MAP_FAILED) {
+        arena->size = round_up(size, page_size);
+        base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (base == MAP_FAILED) {
+            arena->size = 0;
+            return -errno;
+        }
+#ifdef MADV_HUGEPAGE
+        if (try_huge && arena->size >= PW_ARENA_HUGE_PAGE_SIZE)
+            madvise(base, arena->size, MADV_HUGEPAGE);
+#endif
+    }
+
+    arena->base = base;
+    arena->locked = mlock(base, arena->size) == 0;
+
+    /* MAP_POPULATE is only a hint; touch every page so the first cycles after
+     * Start never fault */
+    memset(base, 0, arena->size);
+    return 0;
+}
+
+void pw_arena_clear(struct pw_arena *arena) {
+    if (arena->base) {
+        if (arena->locked)
+            munlock(arena->base, arena->size);
+        munmap(arena->base, arena->size);
+    }
+    memset(arena, 0, sizeof *arena);
+}
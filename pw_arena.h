@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+ * One page-aligned, locked and prefaulted memory block for the audio buffers
+ * of a CreateBuffers/DisposeBuffers cycle.
+ *
+ * Locking and huge pages are best effort: without the privileges or reserved
+ * huge pages the arena still works, it just reports what it could not do.
+ *
+ * This file has no Wine or PipeWire dependencies so that it can be built into
+ * native tools (see bench/).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pw_arena {
+	void *base;
+	/// Mapped size, rounded up to the page (or huge page) size.
+	size_t size;
+	/// Backed by explicit huge pages (MAP_HUGETLB).
+	bool huge;
+	/// mlock() succeeded.
+	bool locked;
+};
+
+/// Maps a zeroed arena of at least `size` bytes. With `try_huge` explicit huge
+/// pages are tried first, then transparent huge pages are requested. Returns
+/// 0 on success, negative errno on failure.
+int pw_arena_init(struct pw_arena *arena, size_t size, bool try_huge);
+/// Unmaps the arena; safe on a zeroed or already cleared arena.
+void pw_arena_clear(struct pw_arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
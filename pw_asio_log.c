@@ -0,0 +1,207 @@
+#include "pw_asio_log.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* How often the drain thread looks at the ring. Producers never wake it, that
+ * would take a syscall on the audio thread. */
+#define DRAIN_INTERVAL_MS 20
+
+#define RECORD_MASK (PW_ASIO_LOG_RECORDS - 1)
+
+_Static_assert((PW_ASIO_LOG_RECORDS & RECORD_MASK) == 0, "PW_ASIO_LOG_RECORDS must be a power of two");
+
+/* Bounded MPSC queue in the style of Vyukov's. Each record carries a sequence
+ * number relative to its lap, lap(pos) = pos & ~RECORD_MASK: it is free for
+ * position `pos` when seq == lap(pos), holds the message written for `pos`
+ * when seq == lap(pos) + 1, and is still owned by the previous lap when it is
+ * below. Relative numbering makes the zeroed ring a valid empty one, so there
+ * is nothing to initialize before the first call. */
+struct record {
+    uint32_t seq;
+    int32_t level;
+    int32_t line;
+    char const *function;
+    uint64_t time_ns;
+    char message[PW_ASIO_LOG_MESSAGE_SIZE];
+} __attribute__((aligned(64)));
+
+static struct {
+    /* Next position to claim, shared by all producers */
+    uint32_t head __attribute__((aligned(64)));
+    uint64_t dropped;
+    int level;
+
+    /* Drain thread only */
+    uint32_t tail __attribute__((aligned(64)));
+    uint64_t dropped_reported;
+
+    pthread_mutex_t lock;
+    pthread_t thread;
+    bool running;
+    bool stopping;
+
+    struct record records[PW_ASIO_LOG_RECORDS];
+} ring = {
+    .level = PW_ASIO_DEFAULT_LOG_LEVEL,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static char const *const level_names[] = { "error", "warning", "info", "debug", "trace" };
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint32_t lap(uint32_t pos) {
+    return pos & ~(uint32_t)RECORD_MASK;
+}
+
+void pw_asio_set_log_level(int level) {
+    if (level < PW_ASIO_LOG_ERROR)
+        level = PW_ASIO_LOG_ERROR;
+    if (level > PW_ASIO_LOG_TRACE)
+        level = PW_ASIO_LOG_TRACE;
+    __atomic_store_n(&ring.level, level, __ATOMIC_RELAXED);
+}
+
+int pw_asio_get_log_level(void) {
+    return __atomic_load_n(&ring.level, __ATOMIC_RELAXED);
+}
+
+uint64_t pw_asio_log_dropped(void) {
+    return __atomic_load_n(&ring.dropped, __ATOMIC_RELAXED);
+}
+
+void pw_asio_log(int level, const char *function, int line, const char *format, ...) {
+    struct record *rec;
+    uint32_t pos, seq;
+    va_list args;
+
+    if (level > pw_asio_get_log_level())
+        return;
+    if (level < PW_ASIO_LOG_ERROR)
+        level = PW_ASIO_LOG_ERROR;
+
+    pos = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+    for (;;) {
+        rec = &ring.records[pos & RECORD_MASK];
+        seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        if (seq == lap(pos)) {
+            if (__atomic_compare_exchange_n(&ring.head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if ((int32_t)(seq - lap(pos)) < 0) {
+            /* The drain thread has not caught up with the previous lap */
+            __atomic_fetch_add(&ring.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+        }
+    }
+
+    rec->level = level;
+    rec->line = line;
+    rec->function = function;
+    rec->time_ns = monotonic_ns();
+    va_start(args, format);
+    vsnprintf(rec->message, sizeof rec->message, format, args);
+    va_end(args);
+    __atomic_store_n(&rec->seq, lap(pos) + 1, __ATOMIC_RELEASE);
+}
+
+static void print_record(struct record const *rec) {
+    FILE *out = rec->level <= PW_ASIO_LOG_ERROR ? stderr : stdout;
+    size_t len = strnlen(rec->message, sizeof rec->message);
+
+    if (len && rec->message[len - 1] == '\n')
+        --len;
+    fprintf(out, "[%llu.%06llu] %s: %s:%d: %.*s\n",
+            (unsigned long long)(rec->time_ns / 1000000000ULL), (unsigned long long)(rec->time_ns % 1000000000ULL / 1000),
+            level_names[rec->level], rec->function ? rec->function : "?", rec->line, (int)len, rec->message);
+}
+
+/* Print everything published so far. The level is checked again here so that
+ * lowering it also hides records that were already queued. */
+static void drain(void) {
+    int level = pw_asio_get_log_level();
+    uint64_t dropped;
+    bool printed = false;
+
+    for (;;) {
+        struct record *rec = &ring.records[ring.tail & RECORD_MASK];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != lap(ring.tail) + 1)
+            break;
+        if (rec->level <= level) {
+            print_record(rec);
+            printed = true;
+        }
+        __atomic_store_n(&rec->seq, lap(ring.tail) + PW_ASIO_LOG_RECORDS, __ATOMIC_RELEASE);
+        ring.tail++;
+    }
+
+    dropped = pw_asio_log_dropped();
+    if (dropped != ring.dropped_reported) {
+        fprintf(stderr, "pw_asio_log: %llu log records dropped (%llu total), ring full\n",
+                (unsigned long long)(dropped - ring.dropped_reported), (unsigned long long)dropped);
+        ring.dropped_reported = dropped;
+        printed = true;
+    }
+    if (printed) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+}
+
+static void *drain_thread(void *arg) {
+    struct timespec interval = { .tv_sec = 0, .tv_nsec = DRAIN_INTERVAL_MS * 1000000L };
+
+    (void)arg;
+    for (;;) {
+        drain();
+        if (__atomic_load_n(&ring.stopping, __ATOMIC_ACQUIRE))
+            break;
+        nanosleep(&interval, NULL);
+    }
+    drain();
+    return NULL;
+}
+
+int pw_asio_log_start(void) {
+    pthread_attr_t attr;
+    struct sched_param param = { .sched_priority = 0 };
+    int res = 0;
+
+    pthread_mutex_lock(&ring.lock);
+    if (!ring.running) {
+        /* Plain time-sharing thread even when started from an RT one */
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+        pthread_attr_setschedparam(&attr, &param);
+        ring.stopping = false;
+        res = -pthread_create(&ring.thread, &attr, drain_thread, NULL);
+        pthread_attr_destroy(&attr);
+        if (!res) {
+            pthread_setname_np(ring.thread, "pw-asio-log");
+            ring.running = true;
+        }
+    }
+    pthread_mutex_unlock(&ring.lock);
+    return res;
+}
+
+void pw_asio_log_stop(void) {
+    pthread_mutex_lock(&ring.lock);
+    if (ring.running) {
+        __atomic_store_n(&ring.stopping, true, __ATOMIC_RELEASE);
+        pthread_join(ring.thread, NULL);
+        ring.running = false;
+    }
+    pthread_mutex_unlock(&ring.lock);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * pw_asio_log() and the PWASIO_LOG_* macros, safe to call from the PipeWire
+ * data thread.
+ *
+ * Callers format their message into one fixed-size record of a preallocated
+ * ring and return; there are no locks, allocations or syscalls on that side.
+ * Any number of threads may log at the same time. A low-priority drain
+ * thread started with pw_asio_log_start() prints the records to
+ * stdout/stderr, filtered by the current log level. When the ring is full
+ * the record is dropped and counted, and the drain thread reports how many
+ * were lost.
+ *
+ * This file has no Wine or PipeWire dependencies so that it can be built into
+ * native tools (see bench/).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PW_ASIO_DEFAULT_LOG_LEVEL       1  // Warning level by default
+
+// Logging levels
+enum pw_asio_log_level {
+    PW_ASIO_LOG_ERROR = 0,
+    PW_ASIO_LOG_WARNING = 1,
+    PW_ASIO_LOG_INFO = 2,
+    PW_ASIO_LOG_DEBUG = 3,
+    PW_ASIO_LOG_TRACE = 4
+};
+
+// Logging functions
+void pw_asio_set_log_level(int level);
+int pw_asio_get_log_level(void);
+void pw_asio_log(int level, const char *function, int line, const char *format, ...)
+	__attribute__((format(printf, 4, 5)));
+
+// Logging macros
+#define PWASIO_LOG_ERROR(format, ...) pw_asio_log(PW_ASIO_LOG_ERROR, __func__, __LINE__, format, ##__VA_ARGS__)
+#define PWASIO_LOG_WARNING(format, ...) pw_asio_log(PW_ASIO_LOG_WARNING, __func__, __LINE__, format, ##__VA_ARGS__)
+#define PWASIO_LOG_INFO(format, ...) pw_asio_log(PW_ASIO_LOG_INFO, __func__, __LINE__, format, ##__VA_ARGS__)
+#define PWASIO_LOG_DEBUG(format, ...) pw_asio_log(PW_ASIO_LOG_DEBUG, __func__, __LINE__, format, ##__VA_ARGS__)
+#define PWASIO_LOG_TRACE(format, ...) pw_asio_log(PW_ASIO_LOG_TRACE, __func__, __LINE__, format, ##__VA_ARGS__)
+
+/// Number of records in the ring, a power of two.
+#define PW_ASIO_LOG_RECORDS 256
+/// Longest message kept; longer ones are truncated.
+#define PW_ASIO_LOG_MESSAGE_SIZE 224
+
+/// Start the drain thread. Records logged before this are kept (up to the
+/// ring size) and printed once it runs. Returns 0 or a negative errno;
+/// calling it again while running is a no-op.
+int pw_asio_log_start(void);
+
+/// Print what is left in the ring and stop the drain thread.
+void pw_asio_log_stop(void);
+
+/// Records lost because the ring was full, since the process started.
+uint64_t pw_asio_log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
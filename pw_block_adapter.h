@@ -0,0 +1,138 @@
+#pragma once
+
+/*
+ * Block adapter between the PipeWire graph quantum and the ASIO buffer size.
+ *
+ * Every channel owns one ring per direction. Each graph cycle pushes the
+ * quantum into the input rings, runs bufferSwitch once for every complete
+ * ASIO block that is available (zero, one or several times), pushes the
+ * host's output into the output rings and pops one quantum from them.
+ *
+ * The output side needs a head start of silence so that a quantum can always
+ * be popped; pw_block_adapter_latency() gives the smallest head start that
+ * works for a quantum/block pair. That head start is the latency the adapter
+ * adds and the driver reports it to the host.
+ *
+ * The rings are single-producer/single-consumer and never allocate; storage
+ * is handed in by the caller. This file has no Wine or PipeWire dependencies
+ * so that it can be built into native tools (see bench/).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Largest graph quantum the rings are sized for. PipeWire caps
+/// clock.max-quantum at 8192.
+#define PW_BLOCK_ADAPTER_MAX_QUANTUM 8192u
+
+struct pw_ring {
+	float *data;
+	uint32_t mask;
+	/// Free-running positions; only the consumer moves `read`, only the
+	/// producer moves `write`.
+	uint32_t read;
+	uint32_t write;
+};
+
+/// Ring capacity in samples (a power of two) for one channel of an adapter
+/// running `block` sized ASIO buffers.
+static inline uint32_t pw_block_adapter_capacity(uint32_t block) {
+	uint32_t needed = PW_BLOCK_ADAPTER_MAX_QUANTUM + 2 * block;
+	uint32_t capacity = 1;
+	while (capacity < needed)
+		capacity <<= 1;
+	return capacity;
+}
+
+static inline uint32_t pw_block_adapter_gcd(uint32_t a, uint32_t b) {
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/// Frames the output side must be ahead of the input by (input ring fill plus
+/// output ring fill at the start of a cycle) so that every cycle can pop
+/// `quantum` frames. The input fill modulo `block` walks through the residues
+/// of `in_fill` modulo gcd(quantum, block), so the worst case is
+/// block - gcd + in_fill % gcd. When the quantum is a multiple of the block
+/// size any leftover input is dropped instead and no head start is needed.
+static inline uint32_t pw_block_adapter_latency(uint32_t quantum, uint32_t block, uint32_t in_fill) {
+	uint32_t gcd;
+
+	if (!quantum || !block || quantum % block == 0)
+		return 0;
+	gcd = pw_block_adapter_gcd(quantum, block);
+	return block - gcd + in_fill % gcd;
+}
+
+/// `capacity` must be a power of two.
+static inline void pw_ring_init(struct pw_ring *ring, float *data, uint32_t capacity) {
+	ring->data = data;
+	ring->mask = capacity - 1;
+	ring->read = 0;
+	ring->write = 0;
+}
+
+/// Only safe while neither side is running.
+static inline void pw_ring_reset(struct pw_ring *ring) {
+	ring->read = 0;
+	ring->write = 0;
+}
+
+static inline uint32_t pw_ring_capacity(struct pw_ring const *ring) {
+	return ring->mask + 1;
+}
+
+static inline uint32_t pw_ring_fill(struct pw_ring const *ring) {
+	return __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t pw_ring_space(struct pw_ring const *ring) {
+	return pw_ring_capacity(ring) - pw_ring_fill(ring);
+}
+
+/// Producer: append `count` samples from `src`, or silence when `src` is NULL.
+/// The caller checks pw_ring_space() first.
+static inline void pw_ring_write(struct pw_ring *ring, float const *src, uint32_t count) {
+	uint32_t write = __atomic_load_n(&ring->write, __ATOMIC_RELAXED);
+	uint32_t offset = write & ring->mask;
+	uint32_t first = pw_ring_capacity(ring) - offset;
+
+	if (first > count)
+		first = count;
+	if (src) {
+		memcpy(ring->data + offset, src, first * sizeof(float));
+		memcpy(ring->data, src + first, (count - first) * sizeof(float));
+	} else {
+		memset(ring->data + offset, 0, first * sizeof(float));
+		memset(ring->data, 0, (count - first) * sizeof(float));
+	}
+	__atomic_store_n(&ring->write, write + count, __ATOMIC_RELEASE);
+}
+
+/// Consumer: remove `count` samples into `dst`, or drop them when `dst` is
+/// NULL. The caller checks pw_ring_fill() first.
+static inline void pw_ring_read(struct pw_ring *ring, float *dst, uint32_t count) {
+	uint32_t read = __atomic_load_n(&ring->read, __ATOMIC_RELAXED);
+	uint32_t offset = read & ring->mask;
+	uint32_t first = pw_ring_capacity(ring) - offset;
+
+	if (first > count)
+		first = count;
+	if (dst) {
+		memcpy(dst, ring->data + offset, first * sizeof(float));
+		memcpy(dst + first, ring->data, (count - first) * sizeof(float));
+	}
+	__atomic_store_n(&ring->read, read + count, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,4 +1,7 @@
 #include "pw_helper_common.h"
+#include "pw_convert.h"
+#include "pw_cycle.h"
+#include "pw_handoff.h"
 #include <string.h>
 
 void pw_asio_init_default_config(struct pw_helper_init_args *args) {
@@ -21,6 +24,19 @@ void pw_asio_init_default_config(struct pw_helper_init_args *args) {
     args->exclusive_mode = 0; // false
     args->rt_priority = 10;
     args->config_file_path = NULL;
+    args->callback_wakeup = PW_HANDOFF_WAKEUP_EVENT;
+    args->callback_spin_us = PW_HANDOFF_DEFAULT_SPIN_US;
+    args->direct_dispatch = 0; // false
+    args->zero_copy = 0; // false
+    args->hugepages = 0; // false
+    args->stats = 1; // true
+    args->late_policy = PW_CYCLE_LATE_SILENCE;
+    args->force_graph_clock = 1; // true
+    args->interleaved_ports = 0; // false
+    args->input_format = PW_SAMPLE_FLOAT32;
+    args->output_format = PW_SAMPLE_FLOAT32;
+    args->debug_logging = 0; // false
+    args->log_level = PW_ASIO_DEFAULT_LOG_LEVEL;
 }
 
 const char *pw_asio_error_string(enum pw_asio_error error) {
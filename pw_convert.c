@@ -0,0 +1,405 @@
+#include "pw_convert.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PW_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+/* Full scale and the largest value below it that still fits, as F32 */
+#define S16_SCALE       32768.0f
+#define S16_MAX         (32767.0f / 32768.0f)
+#define S24_SCALE       8388608.0f
+#define S24_MAX         (8388607.0f / 8388608.0f)
+#define S32_SCALE       2147483648.0f
+#define S32_MAX         0x1.fffffep-1f
+
+/* Int24 goes through a small int32 block that stays in L1 */
+#define S24_BLOCK       64
+
+static void copy_f32(void *dst, void const *src, uint32_t n) {
+    memcpy(dst, src, (size_t)n * sizeof(float));
+}
+
+/* Also maps NaN to `max`, like the SIMD min/max below */
+static inline float clip(float v, float max) {
+    v = v < max ? v : max;
+    return v > -1.0f ? v : -1.0f;
+}
+
+/* Current rounding mode, to nearest even by default, like _mm_cvtps_epi32()
+ * in the SIMD kernels, so that every kernel gives the same samples */
+static inline int32_t round_to_int(float v) {
+    return (int32_t)lrintf(v);
+}
+
+/* Scalar kernels, also the tails of the SIMD ones */
+
+static void f32_to_s16_scalar(void *dst, void const *src, uint32_t n) {
+    int16_t *d = dst;
+    float const *s = src;
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        d[idx] = (int16_t)round_to_int(clip(s[idx], S16_MAX) * S16_SCALE);
+}
+
+static void s16_to_f32_scalar(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    int16_t const *s = src;
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        d[idx] = s[idx] * (1.0f / S16_SCALE);
+}
+
+static void f32_to_s32_scaled_scalar(int32_t *d, float const *s, uint32_t n, float scale, float max) {
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        d[idx] = round_to_int(clip(s[idx], max) * scale);
+}
+
+static void s32_to_f32_scaled_scalar(float *d, int32_t const *s, uint32_t n, float scale) {
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        d[idx] = s[idx] * scale;
+}
+
+static void f32_to_f64_scalar(void *dst, void const *src, uint32_t n) {
+    double *d = dst;
+    float const *s = src;
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        d[idx] = s[idx];
+}
+
+static void f64_to_f32_scalar(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    double const *s = src;
+    uint32_t idx;
+
+    for (idx = 0; idx < n; ++idx)
+        d[idx] = (float)s[idx];
+}
+
+#ifdef PW_CONVERT_X86
+
+#define TARGET_SSE2     __attribute__((target("sse2")))
+#define TARGET_AVX2     __attribute__((target("avx2")))
+#define TARGET_AVX512   __attribute__((target("avx512f")))
+
+/* SSE2, 4 samples per vector. _mm_cvtps_epi32() rounds to nearest. */
+
+static TARGET_SSE2 void f32_to_s16_sse2(void *dst, void const *src, uint32_t n) {
+    int16_t *d = dst;
+    float const *s = src;
+    __m128 scale = _mm_set1_ps(S16_SCALE), lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(S16_MAX);
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        __m128 a = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(s + idx), hi), lo), scale);
+        __m128 b = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(s + idx + 4), hi), lo), scale);
+        _mm_storeu_si128((__m128i *)(d + idx), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    f32_to_s16_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_SSE2 void s16_to_f32_sse2(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    int16_t const *s = src;
+    __m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        __m128i v = _mm_loadu_si128((__m128i const *)(s + idx));
+        /* Sign extend by unpacking into the upper half and shifting back */
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(d + idx, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(d + idx + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+    s16_to_f32_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_SSE2 void f32_to_s32_scaled_sse2(int32_t *d, float const *s, uint32_t n, float scale, float max) {
+    __m128 vscale = _mm_set1_ps(scale), lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(max);
+    uint32_t idx = 0;
+
+    for (; idx + 4 <= n; idx += 4) {
+        __m128 v = _mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(s + idx), hi), lo), vscale);
+        _mm_storeu_si128((__m128i *)(d + idx), _mm_cvtps_epi32(v));
+    }
+    f32_to_s32_scaled_scalar(d + idx, s + idx, n - idx, scale, max);
+}
+
+static TARGET_SSE2 void s32_to_f32_scaled_sse2(float *d, int32_t const *s, uint32_t n, float scale) {
+    __m128 vscale = _mm_set1_ps(scale);
+    uint32_t idx = 0;
+
+    for (; idx + 4 <= n; idx += 4) {
+        __m128i v = _mm_loadu_si128((__m128i const *)(s + idx));
+        _mm_storeu_ps(d + idx, _mm_mul_ps(_mm_cvtepi32_ps(v), vscale));
+    }
+    s32_to_f32_scaled_scalar(d + idx, s + idx, n - idx, scale);
+}
+
+static TARGET_SSE2 void f32_to_f64_sse2(void *dst, void const *src, uint32_t n) {
+    double *d = dst;
+    float const *s = src;
+    uint32_t idx = 0;
+
+    for (; idx + 4 <= n; idx += 4) {
+        __m128 v = _mm_loadu_ps(s + idx);
+        _mm_storeu_pd(d + idx, _mm_cvtps_pd(v));
+        _mm_storeu_pd(d + idx + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    f32_to_f64_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_SSE2 void f64_to_f32_sse2(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    double const *s = src;
+    uint32_t idx = 0;
+
+    for (; idx + 4 <= n; idx += 4) {
+        __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(s + idx));
+        __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(s + idx + 2));
+        _mm_storeu_ps(d + idx, _mm_movelh_ps(a, b));
+    }
+    f64_to_f32_scalar(d + idx, s + idx, n - idx);
+}
+
+/* AVX2, 8 samples per vector */
+
+static TARGET_AVX2 void f32_to_s16_avx2(void *dst, void const *src, uint32_t n) {
+    int16_t *d = dst;
+    float const *s = src;
+    __m256 scale = _mm256_set1_ps(S16_SCALE), lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(S16_MAX);
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(s + idx), hi), lo), scale);
+        __m256 b = _mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(s + idx + 8), hi), lo), scale);
+        /* The pack works per 128 bit lane; put the quarters back in order */
+        __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i *)(d + idx), _mm256_permute4x64_epi64(v, 0xd8));
+    }
+    f32_to_s16_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_AVX2 void s16_to_f32_avx2(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    int16_t const *s = src;
+    __m256 scale = _mm256_set1_ps(1.0f / S16_SCALE);
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i const *)(s + idx)));
+        _mm256_storeu_ps(d + idx, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    s16_to_f32_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_AVX2 void f32_to_s32_scaled_avx2(int32_t *d, float const *s, uint32_t n, float scale, float max) {
+    __m256 vscale = _mm256_set1_ps(scale), lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(max);
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        __m256 v = _mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(s + idx), hi), lo), vscale);
+        _mm256_storeu_si256((__m256i *)(d + idx), _mm256_cvtps_epi32(v));
+    }
+    f32_to_s32_scaled_scalar(d + idx, s + idx, n - idx, scale, max);
+}
+
+static TARGET_AVX2 void s32_to_f32_scaled_avx2(float *d, int32_t const *s, uint32_t n, float scale) {
+    __m256 vscale = _mm256_set1_ps(scale);
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i const *)(s + idx));
+        _mm256_storeu_ps(d + idx, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale));
+    }
+    s32_to_f32_scaled_scalar(d + idx, s + idx, n - idx, scale);
+}
+
+static TARGET_AVX2 void f32_to_f64_avx2(void *dst, void const *src, uint32_t n) {
+    double *d = dst;
+    float const *s = src;
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        _mm256_storeu_pd(d + idx, _mm256_cvtps_pd(_mm_loadu_ps(s + idx)));
+        _mm256_storeu_pd(d + idx + 4, _mm256_cvtps_pd(_mm_loadu_ps(s + idx + 4)));
+    }
+    f32_to_f64_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_AVX2 void f64_to_f32_avx2(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    double const *s = src;
+    uint32_t idx = 0;
+
+    for (; idx + 8 <= n; idx += 8) {
+        __m128 a = _mm256_cvtpd_ps(_mm256_loadu_pd(s + idx));
+        __m128 b = _mm256_cvtpd_ps(_mm256_loadu_pd(s + idx + 4));
+        _mm256_storeu_ps(d + idx, _mm256_set_m128(b, a));
+    }
+    f64_to_f32_scalar(d + idx, s + idx, n - idx);
+}
+
+/* AVX-512, 16 samples per vector */
+
+static TARGET_AVX512 void f32_to_s16_avx512(void *dst, void const *src, uint32_t n) {
+    int16_t *d = dst;
+    float const *s = src;
+    __m512 scale = _mm512_set1_ps(S16_SCALE), lo = _mm512_set1_ps(-1.0f), hi = _mm512_set1_ps(S16_MAX);
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        __m512 v = _mm512_mul_ps(_mm512_max_ps(_mm512_min_ps(_mm512_loadu_ps(s + idx), hi), lo), scale);
+        _mm256_storeu_si256((__m256i *)(d + idx), _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(v)));
+    }
+    f32_to_s16_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_AVX512 void s16_to_f32_avx512(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    int16_t const *s = src;
+    __m512 scale = _mm512_set1_ps(1.0f / S16_SCALE);
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        __m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256((__m256i const *)(s + idx)));
+        _mm512_storeu_ps(d + idx, _mm512_mul_ps(_mm512_cvtepi32_ps(v), scale));
+    }
+    s16_to_f32_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_AVX512 void f32_to_s32_scaled_avx512(int32_t *d, float const *s, uint32_t n, float scale, float max) {
+    __m512 vscale = _mm512_set1_ps(scale), lo = _mm512_set1_ps(-1.0f), hi = _mm512_set1_ps(max);
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        __m512 v = _mm512_mul_ps(_mm512_max_ps(_mm512_min_ps(_mm512_loadu_ps(s + idx), hi), lo), vscale);
+        _mm512_storeu_si512(d + idx, _mm512_cvtps_epi32(v));
+    }
+    f32_to_s32_scaled_scalar(d + idx, s + idx, n - idx, scale, max);
+}
+
+static TARGET_AVX512 void s32_to_f32_scaled_avx512(float *d, int32_t const *s, uint32_t n, float scale) {
+    __m512 vscale = _mm512_set1_ps(scale);
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        __m512i v = _mm512_loadu_si512(s + idx);
+        _mm512_storeu_ps(d + idx, _mm512_mul_ps(_mm512_cvtepi32_ps(v), vscale));
+    }
+    s32_to_f32_scaled_scalar(d + idx, s + idx, n - idx, scale);
+}
+
+static TARGET_AVX512 void f32_to_f64_avx512(void *dst, void const *src, uint32_t n) {
+    double *d = dst;
+    float const *s = src;
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        _mm512_storeu_pd(d + idx, _mm512_cvtps_pd(_mm256_loadu_ps(s + idx)));
+        _mm512_storeu_pd(d + idx + 8, _mm512_cvtps_pd(_mm256_loadu_ps(s + idx + 8)));
+    }
+    f32_to_f64_scalar(d + idx, s + idx, n - idx);
+}
+
+static TARGET_AVX512 void f64_to_f32_avx512(void *dst, void const *src, uint32_t n) {
+    float *d = dst;
+    double const *s = src;
+    uint32_t idx = 0;
+
+    for (; idx + 16 <= n; idx += 16) {
+        _mm256_storeu_ps(d + idx, _mm512_cvtpd_ps(_mm512_loadu_pd(s + idx)));
+        _mm256_storeu_ps(d + idx + 8, _mm512_cvtpd_ps(_mm512_loadu_pd(s + idx + 8)));
+    }
+    f64_to_f32_scalar(d + idx, s + idx, n - idx);
+}
+
+#endif /* PW_CONVERT_X86 */
+
+/* Int32 and packed int24 on top of one instruction set's scaled kernels.
+ * Unpacked int24 sits in the upper three bytes of an int32, so it scales back
+ * like int32. */
+#define DEFINE_CONVERT(name, ISA) \
+    static void f32_to_s32_##name(void *dst, void const *src, uint32_t n) { \
+        f32_to_s32_scaled_##name(dst, src, n, S32_SCALE, S32_MAX); \
+    } \
+    static void s32_to_f32_##name(void *dst, void const *src, uint32_t n) { \
+        s32_to_f32_scaled_##name(dst, src, n, 1.0f / S32_SCALE); \
+    } \
+    static void f32_to_s24_##name(void *dst, void const *src, uint32_t n) { \
+        uint8_t *d = dst; \
+        float const *s = src; \
+        int32_t block[S24_BLOCK]; \
+        uint32_t piece, idx; \
+        for (; n; n -= piece, s += piece) { \
+            piece = n < S24_BLOCK ? n : S24_BLOCK; \
+            f32_to_s32_scaled_##name(block, s, piece, S24_SCALE, S24_MAX); \
+            for (idx = 0; idx < piece; ++idx, d += 3) { \
+                d[0] = (uint8_t)block[idx]; \
+                d[1] = (uint8_t)(block[idx] >> 8); \
+                d[2] = (uint8_t)(block[idx] >> 16); \
+            } \
+        } \
+    } \
+    static void s24_to_f32_##name(void *dst, void const *src, uint32_t n) { \
+        float *d = dst; \
+        uint8_t const *s = src; \
+        int32_t block[S24_BLOCK]; \
+        uint32_t piece, idx; \
+        for (; n; n -= piece, d += piece) { \
+            piece = n < S24_BLOCK ? n : S24_BLOCK; \
+            for (idx = 0; idx < piece; ++idx, s += 3) \
+                block[idx] = (int32_t)((uint32_t)s[0] << 8 | (uint32_t)s[1] << 16 | (uint32_t)s[2] << 24); \
+            s32_to_f32_scaled_##name(d, block, piece, 1.0f / S32_SCALE); \
+        } \
+    } \
+    static struct pw_convert const convert_##name = { \
+        .isa = ISA, \
+        .to_host = { copy_f32, f32_to_s16_##name, f32_to_s24_##name, f32_to_s32_##name, f32_to_f64_##name }, \
+        .from_host = { copy_f32, s16_to_f32_##name, s24_to_f32_##name, s32_to_f32_##name, f64_to_f32_##name }, \
+    };
+
+DEFINE_CONVERT(scalar, PW_CONVERT_SCALAR)
+#ifdef PW_CONVERT_X86
+DEFINE_CONVERT(sse2, PW_CONVERT_SSE2)
+DEFINE_CONVERT(avx2, PW_CONVERT_AVX2)
+DEFINE_CONVERT(avx512, PW_CONVERT_AVX512)
+#endif
+
+struct pw_convert const *pw_convert_for_isa(enum pw_convert_isa isa) {
+#ifdef PW_CONVERT_X86
+    /* Also checks that the OS saves the wider registers */
+    __builtin_cpu_init();
+#endif
+    switch (isa) {
+        case PW_CONVERT_SCALAR: return &convert_scalar;
+#ifdef PW_CONVERT_X86
+        case PW_CONVERT_SSE2: return __builtin_cpu_supports("sse2") ? &convert_sse2 : NULL;
+        case PW_CONVERT_AVX2: return __builtin_cpu_supports("avx2") ? &convert_avx2 : NULL;
+        case PW_CONVERT_AVX512: return __builtin_cpu_supports("avx512f") ? &convert_avx512 : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+struct pw_convert const *pw_convert_best(void) {
+    struct pw_convert const *convert;
+    int isa;
+
+    for (isa = PW_CONVERT_ISA_COUNT - 1; isa > PW_CONVERT_SCALAR; --isa) {
+        if ((convert = pw_convert_for_isa((enum pw_convert_isa)isa)))
+            return convert;
+    }
+    return &convert_scalar;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * Conversion between the F32 samples of the PipeWire ports and the sample
+ * format the host's ASIO buffers are in (ASIOST*LSB, see GetChannelInfo).
+ *
+ * Integers are scaled so that full scale F32 [-1, 1) maps to the full
+ * integer range; F32 beyond it is clipped. Samples are rounded to nearest,
+ * ties to even, the same in every kernel. Int24 is packed, three bytes per
+ * sample.
+ *
+ * The kernels exist in scalar, SSE2, AVX2 and AVX-512 versions, all in one
+ * object built for the baseline target. pw_convert_best() picks the widest
+ * one the CPU supports at run time, so one driver binary runs anywhere.
+ *
+ * This file has no Wine or PipeWire dependencies so that it can be built into
+ * native tools (see bench/).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Sample format of the host's buffers
+enum pw_sample_format {
+	PW_SAMPLE_FLOAT32 = 0,
+	PW_SAMPLE_INT16,
+	PW_SAMPLE_INT24,
+	PW_SAMPLE_INT32,
+	PW_SAMPLE_FLOAT64,
+
+	PW_SAMPLE_FORMAT_COUNT
+};
+
+/// Instruction sets the kernels are built for
+enum pw_convert_isa {
+	PW_CONVERT_SCALAR = 0,
+	PW_CONVERT_SSE2,
+	PW_CONVERT_AVX2,
+	PW_CONVERT_AVX512,
+
+	PW_CONVERT_ISA_COUNT
+};
+
+/// Convert `n_samples` samples from `src` to `dst`, which do not overlap
+typedef void (*pw_convert_func)(void *dst, void const *src, uint32_t n_samples);
+
+struct pw_convert {
+	enum pw_convert_isa isa;
+	/// F32 to each host format; the F32 entry is a copy
+	pw_convert_func to_host[PW_SAMPLE_FORMAT_COUNT];
+	/// Each host format to F32; the F32 entry is a copy
+	pw_convert_func from_host[PW_SAMPLE_FORMAT_COUNT];
+};
+
+/// Kernels for `isa`, NULL when this build or this CPU does not have it
+struct pw_convert const *pw_convert_for_isa(enum pw_convert_isa isa);
+
+/// Kernels for the widest instruction set this CPU has
+struct pw_convert const *pw_convert_best(void);
+
+/// Bytes per sample of `format`
+static inline uint32_t pw_sample_format_size(enum pw_sample_format format) {
+	switch (format) {
+		case PW_SAMPLE_INT16: return 2;
+		case PW_SAMPLE_INT24: return 3;
+		case PW_SAMPLE_FLOAT64: return 8;
+		default: return 4;
+	}
+}
+
+static inline char const *pw_sample_format_name(enum pw_sample_format format) {
+	switch (format) {
+		case PW_SAMPLE_FLOAT32: return "float32";
+		case PW_SAMPLE_INT16: return "int16";
+		case PW_SAMPLE_INT24: return "int24";
+		case PW_SAMPLE_INT32: return "int32";
+		case PW_SAMPLE_FLOAT64: return "float64";
+		default: return "unknown";
+	}
+}
+
+/// Parses the `input_format`/`output_format` config values. Returns -1 if unknown.
+static inline int pw_sample_format_from_string(char const *name) {
+	for (int idx = 0; idx < PW_SAMPLE_FORMAT_COUNT; ++idx) {
+		if (!strcmp(name, pw_sample_format_name((enum pw_sample_format)idx)))
+			return idx;
+	}
+	return -1;
+}
+
+static inline char const *pw_convert_isa_name(enum pw_convert_isa isa) {
+	switch (isa) {
+		case PW_CONVERT_SCALAR: return "scalar";
+		case PW_CONVERT_SSE2: return "sse2";
+		case PW_CONVERT_AVX2: return "avx2";
+		case PW_CONVERT_AVX512: return "avx512";
+		default: return "unknown";
+	}
+}
+
+static inline int pw_convert_isa_from_string(char const *name) {
+	for (int idx = 0; idx < PW_CONVERT_ISA_COUNT; ++idx) {
+		if (!strcmp(name, pw_convert_isa_name((enum pw_convert_isa)idx)))
+			return idx;
+	}
+	return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,589 @@
+#include "pw_cycle.h"
+#include "pw_interleave.h"
+
+#define likely(x)       __builtin_expect(!!(x), 1)
+#define unlikely(x)     __builtin_expect(!!(x), 0)
+
+#define NSEC_PER_SEC    1000000000LL
+
+/* Frames of one channel staged as F32 when interleaved mode converts */
+#define CONVERT_BLOCK   64
+
+static inline void *get_buffer(struct pw_cycle *cycle, IOChannel *chan, uint32_t n_samples) {
+    void *port = __atomic_load_n(&chan->port, __ATOMIC_ACQUIRE);
+    return port ? cycle->ops->get_buffer(cycle->data, port, n_samples) : NULL;
+}
+
+void pw_cycle_reset(struct pw_cycle *cycle, uint32_t block, double rate) {
+    int idx;
+
+    for (idx = 0; idx < cycle->n_inputs; ++idx)
+        pw_ring_reset(&cycle->inputs[idx].ring);
+    for (idx = 0; idx < cycle->n_outputs; ++idx)
+        pw_ring_reset(&cycle->outputs[idx].ring);
+    cycle->block = block;
+    cycle->rate = rate;
+    cycle->buffer_index = 0;
+    cycle->last_done = -1;
+    cycle->adapter_in_fill = cycle->adapter_out_fill = 0;
+    cycle->adapter_latency = 0;
+    cycle->adapter_underruns = 0;
+}
+
+static inline void *route_buffer(struct pw_cycle *cycle, struct pw_cycle_route const *route, uint32_t n_samples) {
+    return cycle->ops->get_buffer(cycle->data, route->port, n_samples);
+}
+
+/* Whether `chan` has host buffers the plan can run on */
+static inline bool routable(IOChannel const *chan, size_t block_bytes) {
+    return chan->host_buffers[0] && chan->host_buffers[1] && chan->buffer_size >= block_bytes && chan->ring_data;
+}
+
+/* Whether `chan` has a way into the graph */
+static inline bool has_port(struct pw_cycle const *cycle, IOChannel const *chan) {
+    return cycle->interleaved || chan->port;
+}
+
+static void add_route(struct pw_cycle_route *route, IOChannel *chan, uint32_t channel) {
+    route->chan = chan;
+    route->port = chan->port;
+    route->channel = channel;
+    route->host_buffers[0] = chan->host_buffers[0];
+    route->host_buffers[1] = chan->host_buffers[1];
+    route->cycle_buffer = NULL;
+}
+
+void pw_cycle_build_plan(struct pw_cycle *cycle, uint32_t block) {
+    struct pw_cycle_plan *plan = &cycle->plans[cycle->next_plan];
+    struct pw_cycle_route *route = cycle->routes + cycle->next_plan * (cycle->n_inputs + cycle->n_outputs);
+    int *const n_outputs[3] = { &plan->n_copied, &plan->n_mapped, &plan->n_silent };
+    size_t input_bytes = (size_t)block * pw_sample_format_size(cycle->input_format);
+    size_t output_bytes = (size_t)block * pw_sample_format_size(cycle->output_format);
+    /* Port buffers are F32, and an interleaved one is never the host's */
+    bool mappable = !cycle->interleaved && cycle->output_format == PW_SAMPLE_FLOAT32;
+    int pass, idx;
+
+    if (!cycle->convert)
+        cycle->convert = pw_convert_best();
+    plan->block = block;
+    plan->input_format = cycle->input_format;
+    plan->output_format = cycle->output_format;
+    plan->to_host = cycle->convert->to_host[cycle->input_format];
+    plan->from_host = cycle->convert->from_host[cycle->output_format];
+
+    plan->inputs = route;
+    plan->n_inputs = 0;
+    for (idx = 0; idx < cycle->n_inputs; ++idx) {
+        IOChannel *chan = &cycle->inputs[idx];
+        if (chan->active && has_port(cycle, chan) && routable(chan, input_bytes)) {
+            add_route(route++, chan, idx);
+            plan->n_inputs++;
+        }
+    }
+
+    /* Copying outputs, zero-copy outputs, then the ones left silent */
+    plan->outputs = route;
+    plan->n_copied = plan->n_mapped = plan->n_silent = 0;
+    for (pass = 0; pass < 3; ++pass) {
+        for (idx = 0; idx < cycle->n_outputs; ++idx) {
+            IOChannel *chan = &cycle->outputs[idx];
+            if (!chan->active || !has_port(cycle, chan))
+                continue;
+            if (pass != (routable(chan, output_bytes) ? !chan->needs_copy && mappable : 2))
+                continue;
+            add_route(route++, chan, idx);
+            ++*n_outputs[pass];
+        }
+    }
+
+    __atomic_store_n(&cycle->plan, plan, __ATOMIC_RELEASE);
+    cycle->next_plan ^= 1;
+}
+
+void pw_cycle_clear_plan(struct pw_cycle *cycle) {
+    __atomic_store_n(&cycle->plan, NULL, __ATOMIC_RELEASE);
+}
+
+static inline void *interleaved_buffer(struct pw_cycle *cycle, void **slot, uint32_t n_samples) {
+    void *port = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    return port ? cycle->ops->get_buffer(cycle->data, port, n_samples) : NULL;
+}
+
+void pw_cycle_silence(struct pw_cycle *cycle, uint32_t quantum) {
+    int idx;
+
+    if (cycle->interleaved) {
+        float *buffer = interleaved_buffer(cycle, &cycle->interleaved_outputs, quantum);
+        if (buffer)
+            __builtin_memset(buffer, 0, (size_t)quantum * cycle->n_outputs * sizeof(float));
+        return;
+    }
+    if (!cycle->outputs)
+        return;
+    for (idx = 0; idx < cycle->n_outputs; ++idx) {
+        void *buffer = get_buffer(cycle, &cycle->outputs[idx], quantum);
+        if (buffer)
+            __builtin_memset(buffer, 0, quantum * sizeof(float));
+    }
+}
+
+/* What the late policy plays on `route` instead of a buffer; NULL for
+ * silence */
+static inline void const *late_source(struct pw_cycle *cycle, struct pw_cycle_route const *route) {
+    if (cycle->late_policy == PW_CYCLE_LATE_HOLD && cycle->last_done >= 0)
+        return route->host_buffers[cycle->last_done];
+    return NULL;
+}
+
+static void fill_late(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, struct pw_cycle_route const *route,
+                      void *buffer, uint32_t quantum) {
+    void const *src = late_source(cycle, route);
+
+    if (!buffer || src == buffer)
+        return;
+    if (src)
+        plan->from_host(buffer, src, quantum);
+    else
+        __builtin_memset(buffer, 0, quantum * sizeof(float));
+}
+
+/* Outputs the plan has no host buffers for. Interleaved outputs get their
+ * silence from pw_interleave(). */
+static void silence_unrouted(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, uint32_t quantum) {
+    struct pw_cycle_route *route = plan->outputs + plan->n_copied + plan->n_mapped;
+    struct pw_cycle_route *end = route + plan->n_silent;
+
+    if (cycle->interleaved)
+        return;
+    for (; route < end; ++route) {
+        void *buffer = route_buffer(cycle, route, quantum);
+        if (buffer)
+            __builtin_memset(buffer, 0, quantum * sizeof(float));
+    }
+}
+
+/* The host is about to own `buffer_index`, so what it held is no longer a
+ * completed buffer */
+static inline void claim_half(struct pw_cycle *cycle, int buffer_index) {
+    if (cycle->last_done == buffer_index)
+        cycle->last_done = -1;
+}
+
+/* pw_ring_read() into a host input buffer, converting on the way. Without
+ * `dst` the frames are dropped. */
+static void ring_to_host(struct pw_cycle_plan const *plan, struct pw_ring *ring, void *dst, uint32_t count) {
+    uint32_t read = __atomic_load_n(&ring->read, __ATOMIC_RELAXED);
+    uint32_t offset = read & ring->mask;
+    uint32_t first = pw_ring_capacity(ring) - offset;
+
+    if (first > count)
+        first = count;
+    if (dst) {
+        plan->to_host(dst, ring->data + offset, first);
+        plan->to_host((char *)dst + (size_t)first * pw_sample_format_size(plan->input_format), ring->data, count - first);
+    }
+    __atomic_store_n(&ring->read, read + count, __ATOMIC_RELEASE);
+}
+
+/* pw_ring_write() from a host output buffer, converting on the way. Without
+ * `src` the ring gets silence. */
+static void host_to_ring(struct pw_cycle_plan const *plan, struct pw_ring *ring, void const *src, uint32_t count) {
+    uint32_t write = __atomic_load_n(&ring->write, __ATOMIC_RELAXED);
+    uint32_t offset = write & ring->mask;
+    uint32_t first = pw_ring_capacity(ring) - offset;
+
+    if (!src) {
+        pw_ring_write(ring, NULL, count);
+        return;
+    }
+    if (first > count)
+        first = count;
+    plan->from_host(ring->data + offset, src, first);
+    plan->from_host(ring->data, (char const *)src + (size_t)first * pw_sample_format_size(plan->output_format), count - first);
+    __atomic_store_n(&ring->write, write + count, __ATOMIC_RELEASE);
+}
+
+/* Append `count` frames of silence to every routed output ring */
+static void pad_output_rings(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, uint32_t count) {
+    struct pw_cycle_route *route = plan->outputs;
+    struct pw_cycle_route *end = route + plan->n_copied + plan->n_mapped;
+
+    for (; route < end; ++route)
+        pw_ring_write(&route->chan->ring, NULL, count);
+    cycle->adapter_out_fill += count;
+}
+
+/* Split `count` interleaved frames into the input rings, one piece for each
+ * stretch that is contiguous in all of them. Without `src` the rings get
+ * silence. */
+static void deinterleave_into_rings(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, float const *src,
+                                    uint32_t count) {
+    struct pw_cycle_route *route, *end = plan->inputs + plan->n_inputs;
+    float **planes = cycle->input_planes;
+
+    if (!src) {
+        for (route = plan->inputs; route < end; ++route)
+            pw_ring_write(&route->chan->ring, NULL, count);
+        return;
+    }
+    while (count) {
+        uint32_t piece = count;
+
+        __builtin_memset(planes, 0, cycle->n_inputs * sizeof *planes);
+        for (route = plan->inputs; route < end; ++route) {
+            struct pw_ring *ring = &route->chan->ring;
+            uint32_t offset = __atomic_load_n(&ring->write, __ATOMIC_RELAXED) & ring->mask;
+            if (pw_ring_capacity(ring) - offset < piece)
+                piece = pw_ring_capacity(ring) - offset;
+            planes[route->channel] = ring->data + offset;
+        }
+        pw_deinterleave(planes, src, cycle->n_inputs, piece);
+        for (route = plan->inputs; route < end; ++route) {
+            struct pw_ring *ring = &route->chan->ring;
+            __atomic_store_n(&ring->write, __atomic_load_n(&ring->write, __ATOMIC_RELAXED) + piece, __ATOMIC_RELEASE);
+        }
+        src += (size_t)piece * cycle->n_inputs;
+        count -= piece;
+    }
+}
+
+/* Merge `count` frames from the routed output rings into `dst`, the way
+ * deinterleave_into_rings() splits them. Without `dst` they are dropped. */
+static void interleave_from_rings(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, float *dst,
+                                  uint32_t count) {
+    struct pw_cycle_route *route, *end = plan->outputs + plan->n_copied + plan->n_mapped;
+    float const **planes = cycle->output_planes;
+
+    if (!dst) {
+        for (route = plan->outputs; route < end; ++route)
+            pw_ring_read(&route->chan->ring, NULL, count);
+        return;
+    }
+    while (count) {
+        uint32_t piece = count;
+
+        __builtin_memset(planes, 0, cycle->n_outputs * sizeof *planes);
+        for (route = plan->outputs; route < end; ++route) {
+            struct pw_ring *ring = &route->chan->ring;
+            uint32_t offset = __atomic_load_n(&ring->read, __ATOMIC_RELAXED) & ring->mask;
+            if (pw_ring_capacity(ring) - offset < piece)
+                piece = pw_ring_capacity(ring) - offset;
+            planes[route->channel] = ring->data + offset;
+        }
+        pw_interleave(dst, planes, cycle->n_outputs, piece);
+        for (route = plan->outputs; route < end; ++route) {
+            struct pw_ring *ring = &route->chan->ring;
+            __atomic_store_n(&ring->read, __atomic_load_n(&ring->read, __ATOMIC_RELAXED) + piece, __ATOMIC_RELEASE);
+        }
+        dst += (size_t)piece * cycle->n_outputs;
+        count -= piece;
+    }
+}
+
+/* Graph quantum differs from the ASIO buffer size, or did so recently and the
+ * rings still hold audio. The quantum is pushed into the input rings, the host
+ * runs once for every complete buffer (possibly zero or several times), and
+ * one quantum is popped from the output rings. The rings together hold
+ * pw_block_adapter_latency() frames so that the pop never comes up short;
+ * that head start is the latency reported on top of the buffer size.
+ *
+ * Without `host_ready`, or once the host missed a deadline, the remaining
+ * buffers of the cycle are skipped: their input is dropped and the late
+ * policy's data goes to the output rings, so the stream stays aligned. */
+static void process_adapted(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, uint32_t quantum, uint64_t nsec,
+                            bool freewheel, bool host_ready) {
+    struct pw_cycle_route *inputs = plan->inputs, *inputs_end = inputs + plan->n_inputs;
+    struct pw_cycle_route *outputs = plan->outputs, *outputs_end = outputs + plan->n_copied + plan->n_mapped;
+    struct pw_cycle_route *route;
+    uint32_t block = plan->block;
+    uint32_t target, latency;
+    int64_t  block_offset;
+
+    if (unlikely(quantum > PW_BLOCK_ADAPTER_MAX_QUANTUM)) {
+        pw_cycle_silence(cycle, quantum);
+        return;
+    }
+
+    /* Move the head start to what this quantum needs. This is a one-off gap
+     * or skip in the audio and only happens when the quantum changes. */
+    target = pw_block_adapter_latency(quantum, block, cycle->adapter_in_fill);
+    latency = cycle->adapter_in_fill + cycle->adapter_out_fill;
+    if (unlikely(latency < target)) {
+        pad_output_rings(cycle, plan, target - latency);
+    } else if (unlikely(latency > target)) {
+        uint32_t drop = latency - target;
+        uint32_t drop_out = drop < cycle->adapter_out_fill ? drop : cycle->adapter_out_fill;
+        uint32_t drop_in = drop - drop_out;
+
+        for (route = outputs; route < outputs_end; ++route)
+            pw_ring_read(&route->chan->ring, NULL, drop_out);
+        for (route = inputs; route < inputs_end; ++route)
+            pw_ring_read(&route->chan->ring, NULL, drop_in);
+        cycle->adapter_out_fill -= drop_out;
+        cycle->adapter_in_fill -= drop_in;
+    }
+
+    /* The first buffer run this cycle may have started in an earlier one */
+    block_offset = -(int64_t)cycle->adapter_in_fill;
+
+    if (cycle->interleaved) {
+        deinterleave_into_rings(cycle, plan, interleaved_buffer(cycle, &cycle->interleaved_inputs, quantum), quantum);
+    } else {
+        for (route = inputs; route < inputs_end; ++route)
+            pw_ring_write(&route->chan->ring, route_buffer(cycle, route, quantum), quantum);
+    }
+    cycle->adapter_in_fill += quantum;
+
+    while (cycle->adapter_in_fill >= block) {
+        int buffer_index = cycle->buffer_index;
+        uint64_t block_nsec = nsec + block_offset * NSEC_PER_SEC / (int64_t)cycle->rate;
+        bool done = false;
+
+        for (route = inputs; route < inputs_end; ++route)
+            ring_to_host(plan, &route->chan->ring, host_ready ? route->host_buffers[buffer_index] : NULL, block);
+        cycle->adapter_in_fill -= block;
+
+        if (likely(host_ready)) {
+            claim_half(cycle, buffer_index);
+            done = cycle->ops->buffer_switch(cycle->data, buffer_index, block_nsec, freewheel);
+        } else {
+            cycle->ops->buffer_skipped(cycle->data, block_nsec);
+        }
+        block_offset += block;
+
+        for (route = outputs; route < outputs_end; ++route)
+            host_to_ring(plan, &route->chan->ring, done ? route->host_buffers[buffer_index] : late_source(cycle, route), block);
+        cycle->adapter_out_fill += block;
+
+        if (likely(done))
+            cycle->last_done = buffer_index;
+        /* The host keeps a half it is late with; skipped buffers never had one */
+        if (host_ready)
+            cycle->buffer_index ^= 1;
+        host_ready = done;
+    }
+
+    /* Cannot happen with the head start above; keep the stream aligned anyway */
+    if (unlikely(cycle->adapter_out_fill < quantum)) {
+        pad_output_rings(cycle, plan, quantum - cycle->adapter_out_fill);
+        cycle->adapter_underruns++;
+    }
+
+    if (cycle->interleaved) {
+        interleave_from_rings(cycle, plan, interleaved_buffer(cycle, &cycle->interleaved_outputs, quantum), quantum);
+    } else {
+        for (route = outputs; route < outputs_end; ++route)
+            pw_ring_read(&route->chan->ring, route_buffer(cycle, route, quantum), quantum);
+    }
+    cycle->adapter_out_fill -= quantum;
+    silence_unrouted(cycle, plan, quantum);
+
+    cycle->adapter_latency = cycle->adapter_in_fill + cycle->adapter_out_fill;
+}
+
+/* process_interleaved() for a host input format other than F32: each routed
+ * channel is gathered into a small F32 block and converted from there into
+ * the host's half */
+static void deinterleave_converted(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, float const *src,
+                                   uint32_t quantum, int buffer_index) {
+    size_t sample_size = pw_sample_format_size(plan->input_format);
+    struct pw_cycle_route *route, *end = plan->inputs + plan->n_inputs;
+    float block[CONVERT_BLOCK];
+    uint32_t offset, piece;
+
+    for (route = plan->inputs; route < end; ++route) {
+        char *dst = route->host_buffers[buffer_index];
+        for (offset = 0; offset < quantum; offset += piece) {
+            piece = quantum - offset < CONVERT_BLOCK ? quantum - offset : CONVERT_BLOCK;
+            pw_deinterleave_channel(block, src + (size_t)offset * cycle->n_inputs + route->channel, cycle->n_inputs, piece);
+            plan->to_host(dst + offset * sample_size, block, piece);
+        }
+    }
+}
+
+/* interleave_outputs() for a host output format other than F32, the other
+ * way around */
+static void interleave_converted(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, float *dst,
+                                 uint32_t quantum, int buffer_index, bool done) {
+    size_t sample_size = pw_sample_format_size(plan->output_format);
+    /* The output planes, holding host format samples here */
+    float const **sources = cycle->output_planes;
+    struct pw_cycle_route *route, *end = plan->outputs + plan->n_copied;
+    float block[CONVERT_BLOCK];
+    uint32_t offset, piece;
+    int channel;
+
+    __builtin_memset(sources, 0, cycle->n_outputs * sizeof *sources);
+    for (route = plan->outputs; route < end; ++route)
+        sources[route->channel] = done ? route->host_buffers[buffer_index] : late_source(cycle, route);
+    for (channel = 0; channel < cycle->n_outputs; ++channel) {
+        char const *src = (char const *)sources[channel];
+        if (!src) {
+            pw_interleave_channel(dst + channel, NULL, cycle->n_outputs, quantum);
+            continue;
+        }
+        for (offset = 0; offset < quantum; offset += piece) {
+            piece = quantum - offset < CONVERT_BLOCK ? quantum - offset : CONVERT_BLOCK;
+            plan->from_host(block, src + offset * sample_size, piece);
+            pw_interleave_channel(dst + (size_t)offset * cycle->n_outputs + channel, block, cycle->n_outputs, piece);
+        }
+    }
+}
+
+/* process_interleaved() and the skip path: merge what the routed outputs
+ * play into the output port, the host's half `buffer_index` when it is
+ * `done`, the late policy's data otherwise */
+static void interleave_outputs(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, uint32_t quantum,
+                               int buffer_index, bool done) {
+    float *buffer = interleaved_buffer(cycle, &cycle->interleaved_outputs, quantum);
+    float const **planes = cycle->output_planes;
+    struct pw_cycle_route *route, *end = plan->outputs + plan->n_copied;
+
+    if (!buffer)
+        return;
+    if (plan->output_format != PW_SAMPLE_FLOAT32) {
+        interleave_converted(cycle, plan, buffer, quantum, buffer_index, done);
+        return;
+    }
+    __builtin_memset(planes, 0, cycle->n_outputs * sizeof *planes);
+    for (route = plan->outputs; route < end; ++route)
+        planes[route->channel] = done ? route->host_buffers[buffer_index] : late_source(cycle, route);
+    pw_interleave(buffer, planes, cycle->n_outputs, quantum);
+}
+
+/* The direct path of interleaved mode: the input port is split straight into
+ * the host's half and the host's outputs are merged straight into the output
+ * port. There is no zero-copy channel to follow. */
+static void process_interleaved(struct pw_cycle *cycle, struct pw_cycle_plan const *plan, uint32_t quantum,
+                                uint64_t nsec, bool freewheel) {
+    float const *buffer = interleaved_buffer(cycle, &cycle->interleaved_inputs, quantum);
+    float **planes = cycle->input_planes;
+    struct pw_cycle_route *route, *end = plan->inputs + plan->n_inputs;
+    int buffer_index = cycle->buffer_index;
+    bool done;
+
+    if (unlikely(buffer && plan->input_format != PW_SAMPLE_FLOAT32)) {
+        deinterleave_converted(cycle, plan, buffer, quantum, buffer_index);
+    } else if (likely(buffer)) {
+        __builtin_memset(planes, 0, cycle->n_inputs * sizeof *planes);
+        for (route = plan->inputs; route < end; ++route)
+            planes[route->channel] = route->host_buffers[buffer_index];
+        pw_deinterleave(planes, buffer, cycle->n_inputs, quantum);
+    }
+
+    claim_half(cycle, buffer_index);
+    done = cycle->ops->buffer_switch(cycle->data, buffer_index, nsec, freewheel);
+    interleave_outputs(cycle, plan, quantum, buffer_index, done);
+    if (likely(done))
+        cycle->last_done = buffer_index;
+
+    cycle->buffer_index = buffer_index ^ 1;
+}
+
+void pw_cycle_process(struct pw_cycle *cycle, uint32_t quantum, uint64_t nsec, bool freewheel) {
+    struct pw_cycle_plan const *plan = __atomic_load_n(&cycle->plan, __ATOMIC_ACQUIRE);
+    struct pw_cycle_route *route, *copied, *mapped, *mapped_end, *inputs_end;
+    size_t buffer_bytes;
+    int    buffer_index;
+    bool   done;
+
+    if (unlikely(!plan || plan->block != cycle->block)) {
+        pw_cycle_silence(cycle, quantum);
+        return;
+    }
+
+    /* Quantum and buffer size differ: go through the block adapter until the
+     * rings have drained again */
+    if (unlikely(quantum != plan->block || cycle->adapter_in_fill || cycle->adapter_out_fill)) {
+        process_adapted(cycle, plan, quantum, nsec, freewheel, true);
+        return;
+    }
+    if (cycle->interleaved) {
+        process_interleaved(cycle, plan, quantum, nsec, freewheel);
+        return;
+    }
+
+    buffer_bytes = (size_t)quantum * sizeof(float);
+    buffer_index = cycle->buffer_index;
+    copied = plan->outputs;
+    mapped = copied + plan->n_copied;
+    mapped_end = mapped + plan->n_mapped;
+    inputs_end = plan->inputs + plan->n_inputs;
+
+    /* Dequeue the output buffers up front. Zero-copy channels hand the host
+     * the port's own two buffers, so the half to run is whichever one the
+     * graph gave us this cycle. */
+    for (route = copied; route < mapped_end; ++route)
+        route->cycle_buffer = route_buffer(cycle, route, quantum);
+    for (route = mapped; route < mapped_end; ++route) {
+        if (route->cycle_buffer == route->host_buffers[0] || route->cycle_buffer == route->host_buffers[1]) {
+            buffer_index = route->cycle_buffer == route->host_buffers[1];
+            break;
+        }
+    }
+    silence_unrouted(cycle, plan, quantum);
+
+    for (route = plan->inputs; route < inputs_end; ++route) {
+        void *buffer = route_buffer(cycle, route, quantum);
+        if (likely(buffer))
+            plan->to_host(route->host_buffers[buffer_index], buffer, quantum);
+    }
+
+    claim_half(cycle, buffer_index);
+    done = cycle->ops->buffer_switch(cycle->data, buffer_index, nsec, freewheel);
+
+    if (unlikely(!done)) {
+        /* A zero-copy output's port buffer is the half the host is still
+         * writing; only the copying outputs get the late policy's data */
+        for (route = copied; route < mapped; ++route)
+            fill_late(cycle, plan, route, route->cycle_buffer, quantum);
+    } else {
+        for (route = copied; route < mapped; ++route) {
+            if (likely(route->cycle_buffer))
+                plan->from_host(route->cycle_buffer, route->host_buffers[buffer_index], quantum);
+        }
+        /* Nothing to do when the host already wrote into the port buffer.
+         * Zero-copy channels are F32, so the rest is a plain copy. */
+        for (route = mapped; route < mapped_end; ++route) {
+            if (route->cycle_buffer && route->cycle_buffer != route->host_buffers[buffer_index])
+                __builtin_memcpy(route->cycle_buffer, route->host_buffers[buffer_index], buffer_bytes);
+        }
+        cycle->last_done = buffer_index;
+    }
+
+    /* Next cycle runs the other half unless the graph says otherwise */
+    cycle->buffer_index = buffer_index ^ 1;
+}
+
+void pw_cycle_skip(struct pw_cycle *cycle, uint32_t quantum, uint64_t nsec) {
+    struct pw_cycle_plan const *plan = __atomic_load_n(&cycle->plan, __ATOMIC_ACQUIRE);
+    struct pw_cycle_route *route, *mapped, *outputs_end;
+    /* The half the late host still holds */
+    int busy_index = cycle->buffer_index ^ 1;
+
+    if (unlikely(!plan || plan->block != cycle->block)) {
+        pw_cycle_silence(cycle, quantum);
+        return;
+    }
+    if (unlikely(quantum != plan->block || cycle->adapter_in_fill || cycle->adapter_out_fill)) {
+        process_adapted(cycle, plan, quantum, nsec, false, false);
+        return;
+    }
+
+    if (cycle->interleaved) {
+        interleave_outputs(cycle, plan, quantum, 0, false);
+        cycle->ops->buffer_skipped(cycle->data, nsec);
+        return;
+    }
+
+    mapped = plan->outputs + plan->n_copied;
+    outputs_end = mapped + plan->n_mapped;
+    for (route = plan->outputs; route < outputs_end; ++route) {
+        void *buffer = route_buffer(cycle, route, quantum);
+        if (route >= mapped && buffer == route->host_buffers[busy_index])
+            continue;
+        fill_late(cycle, plan, route, buffer, quantum);
+    }
+    silence_unrouted(cycle, plan, quantum);
+    cycle->ops->buffer_skipped(cycle->data, nsec);
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+/*
+ * Per-cycle audio work of the driver: moving samples between the PipeWire
+ * port buffers and the ASIO double buffers, running the host once per ASIO
+ * buffer, and the block adapter path for when the graph quantum differs from
+ * the ASIO buffer size (see pw_block_adapter.h).
+ *
+ * When the host does not finish a buffer in time, or is still busy with an
+ * earlier one when the next cycle starts, the outputs of that cycle are
+ * filled according to pw_cycle_late_policy instead and the graph moves on
+ * without waiting.
+ *
+ * Which channels take part is fixed when the host creates its buffers:
+ * pw_cycle_build_plan() compacts the active channels into a routing plan
+ * that the data thread runs without looking at the rest of them.
+ *
+ * In interleaved mode the filter has one port per direction that carries
+ * all configured channels as interleaved F32, instead of one mono port per
+ * channel. Each cycle splits it into the host's planar buffers and merges
+ * them back (see pw_interleave.h); channels the host did not activate are
+ * dropped on the way in and silent on the way out.
+ *
+ * The ports are always F32. When the host's buffers are in another sample
+ * format, the conversion (see pw_convert.h) takes the place of the copy
+ * between port and host buffer, so it costs no extra pass over the audio.
+ *
+ * Port buffers and the host call are reached through pw_cycle_ops, so this
+ * file has no Wine or PipeWire dependencies and the same code can be driven
+ * by native tools with fake ports (see bench/cycle_bench.c).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pw_block_adapter.h"
+#include "pw_convert.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pw_buffer;
+
+#define PW_CYCLE_PORT_NAME_SIZE 32
+
+/// Range of a path latency, as in PipeWire's struct spa_latency_info
+struct pw_cycle_latency {
+	float min_quantum;
+	float max_quantum;
+	uint32_t min_rate;
+	uint32_t max_rate;
+	uint64_t min_ns;
+	uint64_t max_ns;
+};
+
+/// What the outputs play for a buffer the host did not deliver in time.
+enum pw_cycle_late_policy {
+	/// Silence
+	PW_CYCLE_LATE_SILENCE = 0,
+	/// Repeat the last buffer the host completed, silence if there is none
+	PW_CYCLE_LATE_HOLD,
+
+	PW_CYCLE_LATE_COUNT
+};
+
+typedef struct IOChannel
+{
+	bool active;
+	char port_name[PW_CYCLE_PORT_NAME_SIZE];
+	/// Opaque port handle, passed back to pw_cycle_ops.get_buffer(). NULL
+	/// while the channel has no port; it may be cleared between cycles.
+	void *port;
+	struct pw_buffer *buffers[2];
+
+	/// Buffers handed to the host, in the driver's buffer arena or mapped,
+	/// in the host's sample format of the channel's direction
+	void *host_buffers[2];
+	/// Size of each host buffer in bytes
+	size_t buffer_size;
+	/// False when host_buffers are the mapped port buffers, only ever for F32
+	bool needs_copy;
+
+	/// Block adapter ring for quantum != buffer size
+	struct pw_ring ring;
+	float *ring_data;
+
+	/// Latency of the path between this port and the device, from the
+	/// port's SPA_PARAM_Latency
+	struct pw_cycle_latency latency;
+} IOChannel;
+
+struct pw_cycle_ops {
+	/// Buffer of `port` for this cycle, or NULL when it has none
+	void *(*get_buffer)(void *data, void *port, uint32_t n_samples);
+	/// Run the host on `buffer_index` for a buffer that started at `time_ns`.
+	/// Returns false when the host did not finish before its deadline; it
+	/// keeps the buffer half until it does.
+	bool (*buffer_switch)(void *data, int buffer_index, uint64_t time_ns, bool freewheel);
+	/// A buffer that started at `time_ns` passed without running the host
+	/// because it was still busy
+	void (*buffer_skipped)(void *data, uint64_t time_ns);
+};
+
+/// One active channel of a routing plan
+struct pw_cycle_route {
+	IOChannel *chan;
+	/// The channel's port when the plan was built, NULL in interleaved mode
+	void *port;
+	/// Index of the channel, its sample in an interleaved frame
+	uint32_t channel;
+	/// Host buffers, both at least one block
+	void *host_buffers[2];
+	/// Port buffer of the current cycle, data thread scratch
+	void *cycle_buffer;
+};
+
+/// Active channels of one CreateBuffers(), compacted by pw_cycle_build_plan().
+/// Outputs are ordered copying, zero-copy, then those without usable host
+/// buffers, which only ever get silence.
+struct pw_cycle_plan {
+	/// ASIO buffer size in frames the routes were checked against
+	uint32_t block;
+	/// Host sample formats, with the kernels from F32 port samples to the
+	/// input format and from the output format back to F32
+	enum pw_sample_format input_format;
+	enum pw_sample_format output_format;
+	pw_convert_func to_host;
+	pw_convert_func from_host;
+	struct pw_cycle_route *inputs;
+	struct pw_cycle_route *outputs;
+	int n_inputs;
+	int n_copied;
+	int n_mapped;
+	int n_silent;
+};
+
+struct pw_cycle {
+	struct pw_cycle_ops const *ops;
+	void *data;
+
+	/// Configured channels
+	IOChannel *inputs;
+	IOChannel *outputs;
+	int n_inputs;
+	int n_outputs;
+
+	/// Interleaved mode: the ports carrying all inputs and all outputs,
+	/// NULL for a direction without channels or while it has no port yet.
+	/// The channels' own `port` is not used.
+	bool interleaved;
+	void *interleaved_inputs;
+	void *interleaved_outputs;
+
+	/// Sample formats of the host's input and output buffers
+	enum pw_sample_format input_format;
+	enum pw_sample_format output_format;
+	/// Conversion kernels; pw_cycle_build_plan() takes the best ones this
+	/// CPU has when NULL
+	struct pw_convert const *convert;
+
+	/// Room for two plans of n_inputs + n_outputs routes each, so that
+	/// building one never touches the plan the data thread may still read
+	struct pw_cycle_route *routes;
+	/// Interleaved mode: room for n_inputs and n_outputs plane pointers,
+	/// data thread scratch for splitting and merging the ports
+	float **input_planes;
+	float const **output_planes;
+	/// Plan the data thread runs, NULL while the host has no buffers
+	struct pw_cycle_plan *plan;
+	struct pw_cycle_plan plans[2];
+	int next_plan;
+
+	/// ASIO buffer size in frames and the sample rate, set by pw_cycle_reset()
+	uint32_t block;
+	double rate;
+	/// Half of the double buffer the next bufferSwitch runs on
+	int buffer_index;
+
+	enum pw_cycle_late_policy late_policy;
+	/// Half whose outputs the host last completed, -1 when none is intact
+	int last_done;
+
+	/// Block adapter state. The fill levels are shared by all rings of one
+	/// direction; `adapter_latency` is the head start currently held.
+	uint32_t adapter_in_fill;
+	uint32_t adapter_out_fill;
+	uint32_t adapter_latency;
+	uint32_t adapter_underruns;
+};
+
+/// Empty the adapter rings and start over on buffer half 0. Only safe while
+/// pw_cycle_process() is not running.
+void pw_cycle_reset(struct pw_cycle *cycle, uint32_t block, double rate);
+
+/// Route the active channels whose host buffers hold at least `block` frames
+/// of their direction's sample format and publish the result to the data
+/// thread. Outside interleaved mode only channels with a port are routed.
+/// Active outputs without such buffers are played silent; inactive channels
+/// are left alone. Call with the ports and host buffers in place and
+/// pw_cycle_process() not running on a previous plan's buffers.
+void pw_cycle_build_plan(struct pw_cycle *cycle, uint32_t block);
+
+/// Stop routing; cycles play silence until the next pw_cycle_build_plan().
+void pw_cycle_clear_plan(struct pw_cycle *cycle);
+
+/// One graph cycle of `quantum` frames that started at `nsec`.
+void pw_cycle_process(struct pw_cycle *cycle, uint32_t quantum, uint64_t nsec, bool freewheel);
+
+/// One graph cycle of `quantum` frames that started at `nsec` while the host
+/// is still busy with an earlier buffer: the outputs get the late policy's
+/// data and the host is not called.
+void pw_cycle_skip(struct pw_cycle *cycle, uint32_t quantum, uint64_t nsec);
+
+/// Write `quantum` frames of silence to every output port, routed or not.
+void pw_cycle_silence(struct pw_cycle *cycle, uint32_t quantum);
+
+static inline char const *pw_cycle_late_policy_name(enum pw_cycle_late_policy policy) {
+	switch (policy) {
+		case PW_CYCLE_LATE_SILENCE: return "silence";
+		case PW_CYCLE_LATE_HOLD: return "hold";
+		default: return "unknown";
+	}
+}
+
+/// Parses the `late_policy` config value. Returns -1 if unknown.
+static inline int pw_cycle_late_policy_from_string(char const *name) {
+	for (int idx = 0; idx < PW_CYCLE_LATE_COUNT; ++idx) {
+		if (!strcmp(name, pw_cycle_late_policy_name((enum pw_cycle_late_policy)idx)))
+			return idx;
+	}
+	return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
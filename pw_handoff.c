@@ -0,0 +1,237 @@
+#include "pw_handoff.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+static inline void cpu_relax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint32_t gate_load(struct pw_handoff_gate const *gate) {
+    return __atomic_load_n(&gate->seq, __ATOMIC_SEQ_CST);
+}
+
+/* Relative timeout for `timeout_ns`, NULL for a negative one (forever) */
+static struct timespec *ns_to_timespec(int64_t timeout_ns, struct timespec *ts) {
+    if (timeout_ns < 0)
+        return NULL;
+    ts->tv_sec = timeout_ns / 1000000000LL;
+    ts->tv_nsec = timeout_ns % 1000000000LL;
+    return ts;
+}
+
+static int futex_wait(uint32_t *word, uint32_t expected, int64_t timeout_ns) {
+    struct timespec ts, *tsp = ns_to_timespec(timeout_ns, &ts);
+
+    if (syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, tsp, NULL, 0) < 0)
+        return -errno;
+    return 0;
+}
+
+static void futex_wake(uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static int gate_init(struct pw_handoff *handoff, struct pw_handoff_gate *gate) {
+    gate->seq = 0;
+    gate->sleepers = 0;
+    gate->fd = -1;
+    gate->event = NULL;
+
+    switch (handoff->wakeup) {
+        case PW_HANDOFF_WAKEUP_EVENT:
+            if (!handoff->event_ops || !(gate->event = handoff->event_ops->create()))
+                return -ENOMEM;
+            break;
+        case PW_HANDOFF_WAKEUP_EVENTFD:
+            if ((gate->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+                return -errno;
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static void gate_clear(struct pw_handoff *handoff, struct pw_handoff_gate *gate) {
+    if (gate->event)
+        handoff->event_ops->destroy(gate->event);
+    if (gate->fd >= 0)
+        close(gate->fd);
+    gate->event = NULL;
+    gate->fd = -1;
+}
+
+/* Publish `value` and wake the other side if it may be asleep. The sleepers
+ * counter lets the futex backends skip the syscall while the waiter is still
+ * spinning or busy. */
+static void gate_signal(struct pw_handoff *handoff, struct pw_handoff_gate *gate, uint32_t value) {
+    __atomic_store_n(&gate->seq, value, __ATOMIC_SEQ_CST);
+
+    switch (handoff->wakeup) {
+        case PW_HANDOFF_WAKEUP_EVENT:
+            handoff->event_ops->signal(gate->event);
+            break;
+        case PW_HANDOFF_WAKEUP_EVENTFD: {
+            uint64_t one = 1;
+            if (__atomic_load_n(&gate->sleepers, __ATOMIC_SEQ_CST))
+                (void)!write(gate->fd, &one, sizeof one);
+            break;
+        }
+        case PW_HANDOFF_WAKEUP_FUTEX:
+        case PW_HANDOFF_WAKEUP_SPIN:
+            if (__atomic_load_n(&gate->sleepers, __ATOMIC_SEQ_CST))
+                futex_wake(&gate->seq);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Sleep until the gate may have moved away from `old`. Returns 0 on a
+ * wakeup, 1 on timeout, negative when the wait failed; retrying would only
+ * fail again. */
+static int gate_sleep(struct pw_handoff *handoff, struct pw_handoff_gate *gate, uint32_t old, int64_t timeout_ns) {
+    struct timespec ts;
+    int res = 0;
+
+    switch (handoff->wakeup) {
+        case PW_HANDOFF_WAKEUP_EVENT:
+            /* Auto-reset events may carry a stale signal; the caller rechecks
+             * seq. Events only take milliseconds, round up. */
+            res = handoff->event_ops->wait(gate->event,
+                    timeout_ns < 0 ? -1 : (int)((timeout_ns + 999999LL) / 1000000LL));
+            return res < 0 ? res : res == 1;
+        case PW_HANDOFF_WAKEUP_EVENTFD: {
+            struct pollfd pfd = { .fd = gate->fd, .events = POLLIN };
+            uint64_t count;
+            __atomic_add_fetch(&gate->sleepers, 1, __ATOMIC_SEQ_CST);
+            if (gate_load(gate) == old)
+                res = ppoll(&pfd, 1, ns_to_timespec(timeout_ns, &ts), NULL) == 0 ? 1 : 0;
+            __atomic_sub_fetch(&gate->sleepers, 1, __ATOMIC_SEQ_CST);
+            (void)!read(gate->fd, &count, sizeof count);
+            return res;
+        }
+        case PW_HANDOFF_WAKEUP_FUTEX:
+        case PW_HANDOFF_WAKEUP_SPIN:
+            __atomic_add_fetch(&gate->sleepers, 1, __ATOMIC_SEQ_CST);
+            if (gate_load(gate) == old)
+                res = futex_wait(&gate->seq, old, timeout_ns) == -ETIMEDOUT ? 1 : 0;
+            __atomic_sub_fetch(&gate->sleepers, 1, __ATOMIC_SEQ_CST);
+            return res;
+        default:
+            return -EINVAL;
+    }
+}
+
+/* Wait until the gate moves away from `old` or CLOCK_MONOTONIC reaches
+ * `deadline_ns` (0 waits forever). Returns 0 on change, 1 on timeout or when
+ * sleeping failed. */
+static int gate_wait_change(struct pw_handoff *handoff, struct pw_handoff_gate *gate, uint32_t old, uint64_t deadline_ns) {
+    if (gate_load(gate) != old)
+        return 0;
+
+    if (handoff->wakeup == PW_HANDOFF_WAKEUP_SPIN && handoff->spin_ns) {
+        uint64_t spin_end = monotonic_ns() + handoff->spin_ns;
+        if (deadline_ns && spin_end > deadline_ns)
+            spin_end = deadline_ns;
+        do {
+            for (int idx = 0; idx < 64; ++idx) {
+                if (gate_load(gate) != old)
+                    return 0;
+                cpu_relax();
+            }
+        } while (monotonic_ns() < spin_end);
+    }
+
+    while (gate_load(gate) == old) {
+        int64_t remaining_ns = -1;
+        if (deadline_ns) {
+            uint64_t now = monotonic_ns();
+            if (now >= deadline_ns)
+                return 1;
+            remaining_ns = (int64_t)(deadline_ns - now);
+        }
+        if (gate_sleep(handoff, gate, old, remaining_ns) < 0)
+            return 1;
+    }
+    return 0;
+}
+
+static uint64_t timeout_to_deadline(int timeout_ms) {
+    return timeout_ms < 0 ? 0 : monotonic_ns() + (uint64_t)timeout_ms * 1000000ULL;
+}
+
+int pw_handoff_init(struct pw_handoff *handoff, enum pw_handoff_wakeup wakeup,
+        uint32_t spin_us, struct pw_handoff_event_ops const *event_ops) {
+    int res;
+
+    if ((unsigned)wakeup >= PW_HANDOFF_WAKEUP_COUNT)
+        return -EINVAL;
+
+    handoff->wakeup = wakeup;
+    handoff->spin_ns = (uint64_t)spin_us * 1000ULL;
+    /* On a single CPU the other side cannot make progress while we spin */
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        handoff->spin_ns = 0;
+    handoff->event_ops = event_ops;
+    handoff->request.fd = handoff->done.fd = -1;
+    handoff->request.event = handoff->done.event = NULL;
+
+    if ((res = gate_init(handoff, &handoff->request)) < 0 ||
+        (res = gate_init(handoff, &handoff->done)) < 0) {
+        pw_handoff_clear(handoff);
+        return res;
+    }
+    return 0;
+}
+
+void pw_handoff_clear(struct pw_handoff *handoff) {
+    gate_clear(handoff, &handoff->request);
+    gate_clear(handoff, &handoff->done);
+}
+
+bool pw_handoff_idle(struct pw_handoff const *handoff) {
+    return __atomic_load_n(&handoff->done.seq, __ATOMIC_ACQUIRE) ==
+           __atomic_load_n(&handoff->request.seq, __ATOMIC_RELAXED);
+}
+
+uint32_t pw_handoff_post(struct pw_handoff *handoff) {
+    uint32_t ticket = __atomic_load_n(&handoff->request.seq, __ATOMIC_RELAXED) + 1;
+    gate_signal(handoff, &handoff->request, ticket);
+    return ticket;
+}
+
+int pw_handoff_wait_done(struct pw_handoff *handoff, uint32_t ticket, int timeout_ms) {
+    return gate_wait_change(handoff, &handoff->done, ticket - 1, timeout_to_deadline(timeout_ms));
+}
+
+int pw_handoff_wait_done_until(struct pw_handoff *handoff, uint32_t ticket, uint64_t deadline_ns) {
+    return gate_wait_change(handoff, &handoff->done, ticket - 1, deadline_ns ? deadline_ns : 1);
+}
+
+int pw_handoff_wait_request(struct pw_handoff *handoff, uint32_t *last_ticket, int timeout_ms) {
+    int res = gate_wait_change(handoff, &handoff->request, *last_ticket, timeout_to_deadline(timeout_ms));
+    if (res == 0)
+        *last_ticket = gate_load(&handoff->request);
+    return res;
+}
+
+void pw_handoff_complete(struct pw_handoff *handoff, uint32_t ticket) {
+    gate_signal(handoff, &handoff->done, ticket);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+ * Single-producer/single-consumer handoff between the PipeWire data thread
+ * and the Wine thread that runs the ASIO host callbacks.
+ *
+ * A request is a ticket number published in `request.seq`; the consumer
+ * acknowledges it by publishing the same ticket in `done.seq`. The payload
+ * itself lives with the caller and is only written while the handoff is idle,
+ * so the slot needs no lock. How a sleeping side gets woken up is selected
+ * per handoff with `enum pw_handoff_wakeup`.
+ *
+ * This file has no Wine or PipeWire dependencies so that it can be built into
+ * native tools (see bench/).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum pw_handoff_wakeup {
+	/// Caller-supplied event primitive (Win32 auto-reset events in the driver).
+	PW_HANDOFF_WAKEUP_EVENT = 0,
+	/// Raw futex on the sequence word.
+	PW_HANDOFF_WAKEUP_FUTEX,
+	/// One eventfd per direction.
+	PW_HANDOFF_WAKEUP_EVENTFD,
+	/// Busy-wait for the configured spin budget, then futex.
+	PW_HANDOFF_WAKEUP_SPIN,
+
+	PW_HANDOFF_WAKEUP_COUNT
+};
+
+#define PW_HANDOFF_DEFAULT_SPIN_US 20
+
+/// Event primitive used by PW_HANDOFF_WAKEUP_EVENT.
+struct pw_handoff_event_ops {
+	void *(*create)(void);
+	void (*signal)(void *event);
+	/// Returns 0 when signalled, 1 on timeout, negative on error.
+	int (*wait)(void *event, int timeout_ms);
+	void (*destroy)(void *event);
+};
+
+/// One wakeup direction.
+struct pw_handoff_gate {
+	uint32_t seq;
+	uint32_t sleepers;
+	int fd;
+	void *event;
+} __attribute__((aligned(64)));
+
+struct pw_handoff {
+	struct pw_handoff_gate request;
+	struct pw_handoff_gate done;
+	enum pw_handoff_wakeup wakeup;
+	uint64_t spin_ns;
+	struct pw_handoff_event_ops const *event_ops;
+};
+
+/// Returns 0 on success, negative errno on failure. `event_ops` is only used
+/// (and required) for PW_HANDOFF_WAKEUP_EVENT.
+int pw_handoff_init(struct pw_handoff *handoff, enum pw_handoff_wakeup wakeup,
+		uint32_t spin_us, struct pw_handoff_event_ops const *event_ops);
+void pw_handoff_clear(struct pw_handoff *handoff);
+
+/// Producer: true when the last request was acknowledged.
+bool pw_handoff_idle(struct pw_handoff const *handoff);
+/// Producer: publish a new request and wake the consumer. Returns its ticket.
+uint32_t pw_handoff_post(struct pw_handoff *handoff);
+/// Producer: wait until `ticket` is acknowledged. Returns 0 when done,
+/// 1 on timeout. A negative timeout waits forever.
+int pw_handoff_wait_done(struct pw_handoff *handoff, uint32_t ticket, int timeout_ms);
+
+/// Producer: as pw_handoff_wait_done(), but give up once CLOCK_MONOTONIC
+/// reaches `deadline_ns`. A deadline in the past only checks once.
+int pw_handoff_wait_done_until(struct pw_handoff *handoff, uint32_t ticket, uint64_t deadline_ns);
+
+/// Consumer: wait for a ticket newer than `*last_ticket` and store it there.
+/// Returns 0 when a request arrived, 1 on timeout.
+int pw_handoff_wait_request(struct pw_handoff *handoff, uint32_t *last_ticket, int timeout_ms);
+/// Consumer: acknowledge `ticket` and wake the producer.
+void pw_handoff_complete(struct pw_handoff *handoff, uint32_t ticket);
+
+static inline char const *pw_handoff_wakeup_name(enum pw_handoff_wakeup wakeup) {
+	switch (wakeup) {
+		case PW_HANDOFF_WAKEUP_EVENT: return "event";
+		case PW_HANDOFF_WAKEUP_FUTEX: return "futex";
+		case PW_HANDOFF_WAKEUP_EVENTFD: return "eventfd";
+		case PW_HANDOFF_WAKEUP_SPIN: return "spin";
+		default: return "unknown";
+	}
+}
+
+/// Parses the `callback_wakeup` config value. Returns -1 if unknown.
+static inline int pw_handoff_wakeup_from_string(char const *name) {
+	for (int idx = 0; idx < PW_HANDOFF_WAKEUP_COUNT; ++idx) {
+		if (!strcmp(name, pw_handoff_wakeup_name((enum pw_handoff_wakeup)idx)))
+			return idx;
+	}
+	return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
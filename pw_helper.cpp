@@ -1,9 +1,13 @@
 #include "pw_helper.hpp"
 #include "pw_helper_c.h"
 #include "pw_helper_common.h"
+#include "pw_convert.h"
+#include "pw_cycle.h"
+#include "pw_handoff.h"
 
 #include <chrono>
 #include <memory>
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <atomic>
@@ -13,6 +17,7 @@
 #include <thread>
 #include <unordered_map>
 #include <condition_variable>
+#include <future>
 
 #include <spa/utils/dict.h>
 #include <spa/utils/json.h>
@@ -164,6 +169,99 @@ __always_inline PwInterface ProxyPtr<T>::type() const {
 	return ProxyPtr<struct Proxy>(*this).custom()->type;
 }
 
+// Lookup tables for the bound nodes by node.name, object.serial and bound
+// id, kept up to date from Node::update(). `ready` completes once the initial
+// registry roundtrip is done and every node bound by then has sent its info,
+// so lookups can wait on it instead of scanning.
+struct NodeIndex {
+	struct Keys {
+		std::string name;
+		uint64_t serial;
+		bool has_serial;
+		uint32_t id;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<std::string, struct pw_node *, string_view_hasher, std::equal_to<>> by_name;
+	std::unordered_map<uint64_t, struct pw_node *> by_serial;
+	std::unordered_map<uint32_t, struct pw_node *> by_id;
+	std::unordered_map<struct pw_node *, Keys> keys;
+	// Bound nodes whose info has not arrived yet
+	size_t pending = 0;
+	bool initial_done = false;
+	bool ready_set = false;
+	std::promise<void> ready_promise;
+	std::shared_future<void> ready = ready_promise.get_future().share();
+
+	void add_pending() {
+		std::lock_guard<std::mutex> lock(mutex);
+		++pending;
+	}
+
+	void initial_roundtrip_done() {
+		std::lock_guard<std::mutex> lock(mutex);
+		initial_done = true;
+		check_ready_locked();
+	}
+
+	void publish(struct pw_node *node, uint32_t id, std::string_view name, uint64_t serial, bool has_serial) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto [it, first] = keys.try_emplace(node);
+		Keys &k = it->second;
+		if (first) {
+			--pending;
+		} else {
+			erase_locked(node, k);
+		}
+		k = Keys{std::string(name), serial, has_serial, id};
+		if (!k.name.empty())
+			by_name.insert_or_assign(k.name, node);
+		if (has_serial)
+			by_serial.insert_or_assign(serial, node);
+		by_id.insert_or_assign(id, node);
+		check_ready_locked();
+	}
+
+	void remove(struct pw_node *node) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (auto it = keys.find(node); it != keys.end()) {
+			erase_locked(node, it->second);
+			keys.erase(it);
+		} else {
+			--pending;
+		}
+		check_ready_locked();
+	}
+
+	template <typename Map, typename Key>
+	struct pw_node *find(Map const &map, Key const &key) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = map.find(key);
+		return it != map.end() ? it->second : nullptr;
+	}
+
+private:
+	template <typename Map, typename Key>
+	static void erase_if_ours(Map &map, Key const &key, struct pw_node *node) {
+		if (auto it = map.find(key); it != map.end() && it->second == node)
+			map.erase(it);
+	}
+
+	void erase_locked(struct pw_node *node, Keys const &k) {
+		erase_if_ours(by_name, k.name, node);
+		if (k.has_serial)
+			erase_if_ours(by_serial, k.serial, node);
+		erase_if_ours(by_id, k.id, node);
+	}
+
+	void check_ready_locked() {
+		if (initial_done && !pending && !ready_set) {
+			ready_set = true;
+			ready_promise.set_value();
+		}
+	}
+};
+
 struct Node final: Proxy {
 	using ProxyType = struct pw_node;
 
@@ -172,34 +270,39 @@ struct Node final: Proxy {
 	struct spa_hook listener;
 	struct pw_node_info info;
 	string_map properties;
-	std::unordered_map<uint32_t, SpaPod> params;
+	NodeIndex *index;
+
+	// Params are only fetched for the ids someone asked for (subscribe_param),
+	// and the server keeps them up to date from then on
+	std::mutex param_mutex;
+	std::vector<uint32_t> subscribed_params;
+	std::unordered_map<uint32_t, std::vector<SpaPod>> params;
+	std::unordered_map<uint32_t, uint32_t> param_last_index;
 
 	static struct pw_node_events const s_events;
 
-	void init(ProxyPtr<Node> proxy) {
+	void init(ProxyPtr<Node> proxy, NodeIndex *node_index) {
 		new (this) Node;
+		index = node_index;
+		index->add_pending();
 		Proxy::type = PwInterface::Node;
 		info_state.store(ProxyState::Init, std::memory_order_relaxed);
 		param_state.store(ProxyState::Init, std::memory_order_relaxed);
 		listener = {};
 		struct pw_node *raw_proxy = proxy;
 		pw_node_add_listener(raw_proxy, &listener, &s_events, raw_proxy);
-		pw_node_enum_params(raw_proxy, 0, PW_ID_ANY, 0, ~(uint32_t)0, nullptr);
 	}
 
-	// Bad name
-	bool inited(std::mutex& mutex) {
-		auto state = info_state.load(std::memory_order_relaxed);
-		switch (state) {
-			case ProxyState::Init:
-			case ProxyState::Fetching:
-				// For C++17 compatibility, we'll just return false and let caller retry
-				return false;
-			case ProxyState::PropsFilled:
-			case ProxyState::UpdateInProgress:
-				return true;
-		}
-		return false; // Should never reach here, but satisfy compiler
+	// Start following param `id`. Call with the thread loop locked. Returns
+	// false when the id was already subscribed.
+	bool subscribe_param(struct pw_node *proxy, uint32_t id) {
+		std::lock_guard<std::mutex> lock(param_mutex);
+		if (std::find(subscribed_params.begin(), subscribed_params.end(), id) != subscribed_params.end())
+			return false;
+		subscribed_params.push_back(id);
+		// The subscription replaces the previous one, so pass the whole set
+		pw_node_subscribe_params(proxy, subscribed_params.data(), subscribed_params.size());
+		return true;
 	}
 
 	void get_or_wait_for_info(
@@ -253,7 +356,7 @@ struct Node final: Proxy {
 	}
 	#endif
 
-	void update(struct pw_node_info const *new_info) {
+	void update(struct pw_node *proxy, struct pw_node_info const *new_info) {
 		// Simplified for C++17 compatibility
 		info = *new_info;
 		properties.clear();
@@ -263,24 +366,36 @@ struct Node final: Proxy {
 			properties.emplace(std::move(key), std::move(value));
 		}
 		info_state.store(ProxyState::PropsFilled, std::memory_order_release);
+
+		std::string_view name;
+		uint64_t serial = 0;
+		bool has_serial = false;
+		if (auto it = properties.find(PW_KEY_NODE_NAME); it != properties.end())
+			name = it->second;
+		if (auto it = properties.find(PW_KEY_OBJECT_SERIAL); it != properties.end()) {
+			char *end;
+			serial = std::strtoull(it->second.c_str(), &end, 10);
+			has_serial = end != it->second.c_str();
+		}
+		index->publish(proxy, info.id, name, serial, has_serial);
 	}
 
 	void update_param(void *proxy, uint32_t id, uint32_t index, uint32_t next, struct spa_pod const *param) {
-		// Simplified for C++17 compatibility
-		SpaPod pod = SpaPod::make(param);
-		if (auto it = params.find(id); it != params.end()) {
-			it->second = std::move(pod);
-		} else {
-			params.emplace(id, std::move(pod));
-			//pw_node_subscribe_params(proxy, &id, 1);
-		}
+		std::lock_guard<std::mutex> lock(param_mutex);
+		auto &list = params[id];
+		// Every update re-sends all params of the id starting from the first
+		// index, so an index that does not go up starts a new set
+		if (auto it = param_last_index.find(id); it != param_last_index.end() && index <= it->second)
+			list.clear();
+		param_last_index[id] = index;
+		list.push_back(SpaPod::make(param));
 
 		param_state.store(ProxyState::PropsFilled, std::memory_order_release);
 	}
 };
 
 static void node_info_handler(void *proxy, struct pw_node_info const *info) {
-	ProxyPtr<Node>::from_bound(proxy).custom()->update(info);
+	ProxyPtr<Node>::from_bound(proxy).custom()->update(reinterpret_cast<struct pw_node *>(proxy), info);
 }
 
 static void node_param_handler(void *proxy, int seq, uint32_t id, uint32_t index, uint32_t next, struct spa_pod const *param) {
@@ -351,8 +466,9 @@ static int meta_property_handler(void *proxy, uint32_t subject, char const *key,
 	if (!meta->vtable) {
 		return 0;
 	}
-	std::string_view svkey = key;
-	std::string_view svtype = type;
+	// Both are null when all properties of the subject were removed
+	std::string_view svkey = key ? key : "";
+	std::string_view svtype = type ? type : "";
 	//std::printf("[DEBUG] Got property '%s' of type '%s'\n", key, type);
 	for (size_t idx = 0; idx != meta->vtable->num_properties; ++idx) {
 		auto const *prop = meta->vtable->properties[idx];
@@ -542,6 +658,55 @@ MetadataHandler const DefaultNodes::s_handler = {
 	.destroy = [] (Metadata *self) { static_cast<DefaultNodes *>(self)->~DefaultNodes(); },
 };
 
+// The graph clock from the "settings" metadata. Its properties are plain
+// integers on subject 0; clock.force-* win over the defaults when set.
+struct GraphSettings: Metadata {
+	uint32_t quantum = 0, rate = 0, force_quantum = 0, force_rate = 0;
+	// Called on the loop thread when the effective values changed
+	void (*changed)(void *data, uint32_t quantum, uint32_t rate) = nullptr;
+	void *changed_data = nullptr;
+
+	static MetadataHandler const s_handler;
+
+	void init(ProxyPtr<GraphSettings> proxy) {
+		Metadata::init(proxy);
+		new (this) GraphSettings;
+		Metadata::vtable = &s_handler;
+	}
+
+	uint32_t effective_quantum() const { return force_quantum ? force_quantum : quantum; }
+	uint32_t effective_rate() const { return force_rate ? force_rate : rate; }
+};
+
+static void graph_settings_prop(ProxyPtr<Metadata> proxy, uint32_t subject, char const *key, char const *, char const *value) {
+	auto *settings = proxy.to_derived<GraphSettings>().custom();
+	uint32_t quantum = settings->effective_quantum(), rate = settings->effective_rate();
+	uint32_t parsed = value ? static_cast<uint32_t>(std::strtoul(value, nullptr, 10)) : 0;
+
+	if (subject != 0)
+		return;
+	if (!key) {
+		// All properties of the subject were removed
+		settings->quantum = settings->rate = settings->force_quantum = settings->force_rate = 0;
+	} else {
+		std::string_view svkey = key;
+		if (svkey == "clock.quantum") settings->quantum = parsed;
+		else if (svkey == "clock.rate") settings->rate = parsed;
+		else if (svkey == "clock.force-quantum") settings->force_quantum = parsed;
+		else if (svkey == "clock.force-rate") settings->force_rate = parsed;
+		else return;
+	}
+	if (settings->changed && (quantum != settings->effective_quantum() || rate != settings->effective_rate()))
+		settings->changed(settings->changed_data, settings->effective_quantum(), settings->effective_rate());
+}
+
+MetadataHandler const GraphSettings::s_handler = {
+	.properties = nullptr,
+	.num_properties = 0,
+	.generic_prop = graph_settings_prop,
+	.destroy = [] (Metadata *self) { static_cast<GraphSettings *>(self)->~GraphSettings(); },
+};
+
 struct Helper {
 	//struct pw_main_loop *main_loop = {};
 	struct pw_thread_loop *thread_loop = {};
@@ -556,16 +721,27 @@ struct Helper {
 
 	std::unordered_map<uint32_t, ProxyPtr<Proxy>> bound_proxies;
 	ProxyPtr<DefaultNodes> default_nodes = {};
+	ProxyPtr<GraphSettings> graph_settings = {};
+	NodeIndex node_index;
 
 	std::atomic<InitState> init_state = InitState::Init;
 	std::atomic<int> roundtrip_state = -1;
 	std::mutex state_mutex;
+	// Set when the connection to the server is lost; a shared helper in
+	// this state is not handed out again
+	std::atomic<bool> core_failed = false;
 
 	struct spa_hook roundtrip = {};
 
 	// Device hot-plug callback (optional)
 	PwHelper::DeviceCallback device_cb;
 
+	// Graph clock from the settings metadata and who wants to hear about it,
+	// see add_settings_listener()
+	std::mutex settings_mutex;
+	uint32_t settings_quantum = 0, settings_rate = 0;
+	std::vector<std::pair<PwHelper::SettingsCallback, void *>> settings_listeners;
+
 	// Worker system for deferred operations
 	std::atomic<bool> worker_running = false;
 	std::mutex worker_mutex;
@@ -573,6 +749,17 @@ struct Helper {
 	enum pw_op_type pending_operation = PW_OP_NONE;
 	void *operation_userdata = nullptr;
 
+	// Sequence of the last core done event, see sync()
+	std::mutex sync_mutex;
+	std::condition_variable sync_cond;
+	bool sync_any_done = false;
+	uint32_t sync_done_seq = 0;
+
+	// Bumped from the filter's state_changed event (user_pw_notify_filter_state)
+	std::mutex filter_state_mutex;
+	std::condition_variable filter_state_cond;
+	uint64_t filter_state_seq = 0;
+
 	~Helper() {
 		if (core) {
 			pw_core_disconnect(core);
@@ -698,66 +885,75 @@ struct Helper {
 		}
 	}
 
-	// Add method to wait for filter state transitions with timeout
+	// One server roundtrip: everything requested before has been answered
+	// when this returns true. Must not be called with the loop locked.
+	bool sync(int timeout_ms) {
+		pw_thread_loop_lock(thread_loop);
+		uint32_t seq = pw_core_sync(core, PW_ID_CORE, 0);
+		pw_thread_loop_unlock(thread_loop);
+
+		std::unique_lock<std::mutex> lock(sync_mutex);
+		return sync_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+			return sync_any_done && (int32_t)(sync_done_seq - seq) >= 0;
+		});
+	}
+
+	void notify_filter_state_changed() {
+		{
+			std::lock_guard<std::mutex> lock(filter_state_mutex);
+			++filter_state_seq;
+		}
+		filter_state_cond.notify_all();
+	}
+
+	// Wait until the filter reaches target_state. Sleeps until the filter's
+	// state_changed event fires rather than polling, so this returns as soon
+	// as the graph has done its part.
 	bool wait_for_filter_state_transition(struct pw_filter *filter, enum pw_filter_state target_state, int timeout_ms = 5000) {
 		if (!filter) return false;
-		
+
 		auto start_time = std::chrono::steady_clock::now();
-		auto timeout_duration = std::chrono::milliseconds(timeout_ms);
-		
+		auto deadline = start_time + std::chrono::milliseconds(timeout_ms);
+		auto elapsed_ms = [&] {
+			return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start_time).count();
+		};
+
 		printf("Waiting for filter state transition to %s (timeout: %d ms)\n", 
 		                 pw_filter_state_as_string(target_state), timeout_ms);
-		
-		int iteration = 0;
+
 		enum pw_filter_state last_state = PW_FILTER_STATE_ERROR;
-		
-		// Adaptive timing based on timeout duration - more aggressive for longer timeouts
-		bool is_long_timeout = timeout_ms > 10000;
-		int initial_fast_iterations = is_long_timeout ? 200 : 100;
-		int fast_delay_ms = is_long_timeout ? 2 : 5;
-		int slow_delay_ms = is_long_timeout ? 5 : 10;
-		
-		while (std::chrono::steady_clock::now() - start_time < timeout_duration) {
+		std::unique_lock<std::mutex> lock(filter_state_mutex);
+		for (;;) {
+			// The filter updates its state before emitting the event, so a
+			// change after this read always bumps the sequence we wait on
+			uint64_t seen = filter_state_seq;
 			enum pw_filter_state current_state = pw_filter_get_state(filter, nullptr);
-			
-			// Log state changes
+
 			if (current_state != last_state) {
-				printf("Filter state changed: %s -> %s (iteration %d)\n", 
+				printf("Filter state changed: %s -> %s (%lld ms)\n", 
 				                 pw_filter_state_as_string(last_state), 
-				                 pw_filter_state_as_string(current_state), iteration);
+				                 pw_filter_state_as_string(current_state), elapsed_ms());
 				last_state = current_state;
 			}
-			
+
 			if (current_state == target_state) {
-				printf("Filter reached target state %s after %d iterations\n", 
-				                 pw_filter_state_as_string(target_state), iteration);
+				printf("Filter reached target state %s after %lld ms\n", 
+				                 pw_filter_state_as_string(target_state), elapsed_ms());
 				return true;
 			}
-			
+
 			if (current_state == PW_FILTER_STATE_ERROR) {
 				printf("Filter entered error state during state transition wait\n");
 				return false;
 			}
-			
-			// More aggressive event processing for faster state transitions
-			if (iteration < initial_fast_iterations) {
-				trigger_event_processing();
-				// Very short delay for initial iterations
-				std::this_thread::sleep_for(std::chrono::milliseconds(fast_delay_ms));
-			} else {
-				// Less frequent processing after initial period
-				if (iteration % 15 == 0) {
-					trigger_event_processing();
-				}
-				std::this_thread::sleep_for(std::chrono::milliseconds(slow_delay_ms));
-			}
-			
-			iteration++;
+
+			if (!filter_state_cond.wait_until(lock, deadline, [&] { return filter_state_seq != seen; }))
+				break;
 		}
-		
-		enum pw_filter_state final_state = pw_filter_get_state(filter, nullptr);
-		printf("Filter state transition timeout after %d iterations. Final state: %s, target: %s\n", 
-		                 iteration, pw_filter_state_as_string(final_state), 
+
+		printf("Filter state transition timeout after %lld ms. Final state: %s, target: %s\n", 
+		                 elapsed_ms(), pw_filter_state_as_string(pw_filter_get_state(filter, nullptr)), 
 		                 pw_filter_state_as_string(target_state));
 		return false;
 	}
@@ -788,6 +984,27 @@ static PwInterface get_known_interface(char const *type) {
 	return PwInterface::Unknown;
 }
 
+// Only audio devices are of interest to the driver and the settings dialog.
+// Streams, video, MIDI and the like are never bound, which keeps startup
+// fast on busy graphs.
+static bool is_wanted_node(struct spa_dict const *props) {
+	char const *media_class = props ? spa_dict_lookup(props, PW_KEY_MEDIA_CLASS) : nullptr;
+	if (!media_class)
+		return false;
+	std::string_view sv = media_class;
+	return sv.starts_with("Audio/Sink"sv) || sv.starts_with("Audio/Source"sv) || sv.starts_with("Audio/Duplex"sv);
+}
+
+// Loop thread, from the settings metadata
+static void graph_settings_changed(void *data, uint32_t quantum, uint32_t rate) {
+	Helper *This = reinterpret_cast<Helper *>(data);
+	std::lock_guard<std::mutex> lock(This->settings_mutex);
+	This->settings_quantum = quantum;
+	This->settings_rate = rate;
+	for (auto const &[callback, userdata] : This->settings_listeners)
+		callback(quantum, rate, userdata);
+}
+
 static void registry_global_handler(
 	void *data, uint32_t id, uint32_t permissions,
 	char const *type, uint32_t version, struct spa_dict const *props
@@ -797,10 +1014,12 @@ static void registry_global_handler(
 	struct pw_node *added_node = nullptr;
 	switch (get_known_interface(type)) {
 		case PwInterface::Node: {
+			if (!is_wanted_node(props))
+				break;
 			This->lock();
 			auto proxy = ProxyPtr<Node>::from_bound(
 				pw_registry_bind(This->registry, id, type, std::min(version, (uint32_t)PW_VERSION_NODE), sizeof(Node)));
-			proxy.custom()->init(proxy);
+			proxy.custom()->init(proxy, &This->node_index);
 			This->bound_proxies.emplace(id, proxy);
 			cb = This->device_cb;
 			added_node = proxy;
@@ -819,6 +1038,16 @@ static void registry_global_handler(
 				}
 				This->default_nodes = proxy;
 				This->unlock();
+			} else if ("settings"sv == spa_dict_lookup(props, PW_KEY_METADATA_NAME)) {
+				This->lock();
+				auto proxy = ProxyPtr<GraphSettings>::from_bound(
+					pw_registry_bind(This->registry, id, type, std::min(version, (uint32_t)PW_VERSION_METADATA), sizeof(GraphSettings)));
+				proxy.custom()->init(proxy);
+				proxy.custom()->changed = graph_settings_changed;
+				proxy.custom()->changed_data = This;
+				This->bound_proxies.emplace(id, proxy);
+				This->graph_settings = proxy;
+				This->unlock();
 			}
 			break;
 		}
@@ -838,12 +1067,16 @@ static void registry_global_remove_handler(void *data, uint32_t id) {
 	switch (This->get_proxy(id, global)) {
 		case PwInterface::Node:
 			removed_node = global.to_derived<Node>();
+			This->node_index.remove(removed_node);
 			global.to_derived<Node>().custom()->~Node();
 			goto destroy_proxy;
 		case PwInterface::Metadata:
 			if (This->default_nodes == global) {
 				This->default_nodes = nullptr;
 			}
+			if (This->graph_settings == global) {
+				This->graph_settings = nullptr;
+			}
 			global.to_derived<Metadata>().custom()->~Metadata();
 			goto destroy_proxy;
 
@@ -872,13 +1105,29 @@ static void roundtrip_handler(void *data, uint32_t id, int seq) {
 		// This is to test whether the initialization code propely waits for the roundtrip.
 		std::this_thread::sleep_for(std::chrono::seconds(2));
 	}
+	if (This->init_state.load(std::memory_order_relaxed) != InitState::Running)
+		This->node_index.initial_roundtrip_done();
 	This->init_state.store(InitState::Running, std::memory_order_relaxed);
-	// Removed notify_all for C++17 compatibility
+	{
+		std::lock_guard<std::mutex> lock(This->sync_mutex);
+		This->sync_any_done = true;
+		This->sync_done_seq = seq;
+	}
+	This->sync_cond.notify_all();
+}
+
+static void core_error_handler(void *data, uint32_t id, int seq, int res, const char *message) {
+	Helper *This = reinterpret_cast<Helper *>(data);
+	if (id == PW_ID_CORE && res == -EPIPE) {
+		std::fprintf(stderr, "PipeWire connection lost: %s\n", message);
+		This->core_failed.store(true, std::memory_order_relaxed);
+	}
 }
 
 static struct pw_core_events const s_core_events = {
 	.version = PW_VERSION_CORE_EVENTS,
 	.done = roundtrip_handler,
+	.error = core_error_handler,
 };
 
 Helper *create_helper(int argc, char **argv, InitArgs const *conf) {
@@ -970,6 +1219,32 @@ void destroy_helper(Helper *helper) {
 	delete helper;
 }
 
+int get_node_params(Helper *helper, struct pw_node *node, uint32_t id, struct spa_pod **out, int max, int timeout_ms) {
+	Node *custom = ProxyPtr<Node>(node).custom();
+	bool fresh;
+	int count = 0;
+
+	pw_thread_loop_lock(helper->thread_loop);
+	fresh = custom->subscribe_param(node, id);
+	pw_thread_loop_unlock(helper->thread_loop);
+
+	// The server answers in order, so after a roundtrip the first set is in
+	if (fresh && !helper->sync(timeout_ms))
+		return -ETIMEDOUT;
+
+	std::lock_guard<std::mutex> lock(custom->param_mutex);
+	if (auto it = custom->params.find(id); it != custom->params.end()) {
+		for (auto const &pod : it->second) {
+			if (count == max)
+				break;
+			if (!(out[count] = spa_pod_copy(pod)))
+				break;
+			++count;
+		}
+	}
+	return count;
+}
+
 std::vector<struct pw_node *> enumerate_pipewire_endpoints(Helper *helper) {
 	std::vector<struct pw_node *> nodes;
 	helper->lock();
@@ -982,59 +1257,44 @@ std::vector<struct pw_node *> enumerate_pipewire_endpoints(Helper *helper) {
 	return nodes;
 }
 
-static struct pw_node *find_node_by_name_locked(Helper *helper, std::string_view name) {
-	std::string nod_name;
-	std::vector<std::pair<std::string_view, std::string*> > props {
-			{PW_KEY_NODE_NAME, &nod_name},
-	};
-	struct pw_node *found = nullptr;
-	for (auto it = helper->bound_proxies.begin(), end = helper->bound_proxies.end(); it != end; ++it) {
-		if (it->second.type() == PwInterface::Node) {
-			it->second.to_derived<Node>().custom()->get_or_wait_for_info(nullptr, nullptr, props);
-			if (nod_name == name) {
-				found = it->second.to_derived<Node>();
-				break;
-			}
-		}
-	}
-	return found;
-}
+// Longest a lookup waits for the registry to fill after the helper starts
+static constexpr auto NODES_READY_TIMEOUT = std::chrono::milliseconds(2000);
 
-static void wait_for_nodes_init(Helper *helper, std::mutex &mutex) {
-	retry:
-	for (auto it = helper->bound_proxies.begin(), end = helper->bound_proxies.end(); it != end; ++it) {
-		if (it->second.type() == PwInterface::Node) {
-			if (!it->second.to_derived<Node>().custom()->inited(mutex)) {
-				goto retry;
-			}
-		}
-	}
+static void wait_for_nodes_ready(Helper *helper) {
+	if (helper->node_index.ready.wait_for(NODES_READY_TIMEOUT) != std::future_status::ready)
+		std::fputs("Timed out waiting for node info, lookups may miss nodes\n", stderr);
 }
 
 struct pw_node *get_default_node(Helper *helper, enum spa_direction direction) {
-	struct pw_node *node = nullptr;
+	std::string name;
+	wait_for_nodes_ready(helper);
 	helper->lock();
 	if (helper->default_nodes) {
 		auto *nodes = helper->default_nodes.custom();
 		nodes->mutex.lock();
-		wait_for_nodes_init(helper, nodes->mutex);
-		std::string_view name;
 		switch (direction) {
 			case SPA_DIRECTION_INPUT: name = nodes->default_source; break;
 			case SPA_DIRECTION_OUTPUT: name = nodes->default_sink; break;
 		}
-		node = find_node_by_name_locked(helper, name);
 		nodes->mutex.unlock();
 	}
 	helper->unlock();
-	return node;
+	return name.empty() ? nullptr : helper->node_index.find(helper->node_index.by_name, std::string_view(name));
 }
 
 struct pw_node *find_node_by_name(Helper *helper, char const *name) {
-	helper->lock();
-	struct pw_node *found = find_node_by_name_locked(helper, name);
-	helper->unlock();
-	return found;
+	wait_for_nodes_ready(helper);
+	return helper->node_index.find(helper->node_index.by_name, std::string_view(name));
+}
+
+struct pw_node *find_node_by_serial(Helper *helper, uint64_t serial) {
+	wait_for_nodes_ready(helper);
+	return helper->node_index.find(helper->node_index.by_serial, serial);
+}
+
+struct pw_node *find_node_by_id(Helper *helper, uint32_t id) {
+	wait_for_nodes_ready(helper);
+	return helper->node_index.find(helper->node_index.by_id, id);
 }
 
 void get_node_props(Helper *helper, struct pw_node *proxy, std::vector<std::pair<std::string_view, std::string*> > const& props) {
@@ -1062,6 +1322,61 @@ void user_pw_destroy_helper(struct user_pw_helper *helper) {
 	destroy_helper(reinterpret_cast<Helper *>(helper));
 }
 
+// Process-wide helper shared by all driver instances. It outlives the last
+// reference so that re-opening the driver finds the connection and the node
+// cache already warm.
+static std::mutex s_shared_mutex;
+static Helper *s_shared_helper = nullptr;
+static unsigned s_shared_refs = 0;
+
+struct user_pw_helper *user_pw_acquire_helper(struct pw_helper_init_args const *conf) {
+	std::lock_guard<std::mutex> lock(s_shared_mutex);
+
+	if (s_shared_helper && s_shared_helper->core_failed.load(std::memory_order_relaxed) && !s_shared_refs) {
+		std::puts("Dropping shared PipeWire helper after connection loss");
+		destroy_helper(s_shared_helper);
+		s_shared_helper = nullptr;
+	}
+
+	if (s_shared_helper) {
+		if (conf->loop)
+			*conf->loop = pw_thread_loop_get_loop(s_shared_helper->thread_loop);
+		if (conf->context)
+			*conf->context = s_shared_helper->context;
+		if (conf->core)
+			*conf->core = s_shared_helper->core;
+		++s_shared_refs;
+		std::printf("Reusing shared PipeWire helper (%u references)\n", s_shared_refs);
+		return reinterpret_cast<struct user_pw_helper *>(s_shared_helper);
+	}
+
+	if (!(s_shared_helper = create_helper(0, nullptr, conf)))
+		return nullptr;
+	s_shared_refs = 1;
+	return reinterpret_cast<struct user_pw_helper *>(s_shared_helper);
+}
+
+void user_pw_release_helper(struct user_pw_helper *helper) {
+	std::lock_guard<std::mutex> lock(s_shared_mutex);
+	Helper *h = reinterpret_cast<Helper *>(helper);
+
+	if (!h || h != s_shared_helper || !s_shared_refs)
+		return;
+	if (--s_shared_refs == 0 && h->core_failed.load(std::memory_order_relaxed)) {
+		destroy_helper(h);
+		s_shared_helper = nullptr;
+	}
+}
+
+void user_pw_shutdown_shared_helper(void) {
+	std::lock_guard<std::mutex> lock(s_shared_mutex);
+
+	if (s_shared_helper && !s_shared_refs) {
+		destroy_helper(s_shared_helper);
+		s_shared_helper = nullptr;
+	}
+}
+
 struct pw_node *user_pw_get_default_node(struct user_pw_helper *helper, enum spa_direction direction) {
 	return get_default_node(reinterpret_cast<Helper *>(helper), direction);
 }
@@ -1070,6 +1385,14 @@ struct pw_node *user_pw_find_node_by_name(struct user_pw_helper *helper, char co
 	return find_node_by_name(reinterpret_cast<Helper *>(helper), name);
 }
 
+struct pw_node *user_pw_find_node_by_serial(struct user_pw_helper *helper, uint64_t serial) {
+	return find_node_by_serial(reinterpret_cast<Helper *>(helper), serial);
+}
+
+struct pw_node *user_pw_find_node_by_id(struct user_pw_helper *helper, uint32_t id) {
+	return find_node_by_id(reinterpret_cast<Helper *>(helper), id);
+}
+
 void user_pw_lock_loop(struct user_pw_helper *helper) {
 	lock_loop(reinterpret_cast<Helper *>(helper));
 }
@@ -1178,6 +1501,54 @@ void pw_asio_apply_env_overrides(struct pw_helper_init_args *args) {
 	v = std::getenv("PIPEWIREASIO_EXCLUSIVE_MODE");
 	args->exclusive_mode = env_to_bool(v, args->exclusive_mode);
 
+	v = std::getenv("PIPEWIREASIO_CALLBACK_WAKEUP");
+	if (v && *v) {
+		int wakeup = pw_handoff_wakeup_from_string(v);
+		if (wakeup >= 0) args->callback_wakeup = wakeup;
+	}
+
+	v = std::getenv("PIPEWIREASIO_CALLBACK_SPIN_US");
+	args->callback_spin_us = env_to_uint(v, args->callback_spin_us);
+
+	v = std::getenv("PIPEWIREASIO_DIRECT_DISPATCH");
+	args->direct_dispatch = env_to_bool(v, args->direct_dispatch);
+
+	v = std::getenv("PIPEWIREASIO_ZERO_COPY");
+	args->zero_copy = env_to_bool(v, args->zero_copy);
+
+	v = std::getenv("PIPEWIREASIO_HUGEPAGES");
+	args->hugepages = env_to_bool(v, args->hugepages);
+
+	v = std::getenv("PIPEWIREASIO_STATS");
+	args->stats = env_to_bool(v, args->stats);
+
+	v = std::getenv("PIPEWIREASIO_LATE_POLICY");
+	if (v && *v) {
+		int policy = pw_cycle_late_policy_from_string(v);
+		if (policy >= 0) args->late_policy = policy;
+	}
+
+	v = std::getenv("PIPEWIREASIO_FORCE_GRAPH_CLOCK");
+	args->force_graph_clock = env_to_bool(v, args->force_graph_clock);
+
+	v = std::getenv("PIPEWIREASIO_INTERLEAVED_PORTS");
+	args->interleaved_ports = env_to_bool(v, args->interleaved_ports);
+
+	v = std::getenv("PIPEWIREASIO_INPUT_FORMAT");
+	if (v && *v) {
+		int format = pw_sample_format_from_string(v);
+		if (format >= 0) args->input_format = format;
+	}
+
+	v = std::getenv("PIPEWIREASIO_OUTPUT_FORMAT");
+	if (v && *v) {
+		int format = pw_sample_format_from_string(v);
+		if (format >= 0) args->output_format = format;
+	}
+
+	v = std::getenv("PIPEWIREASIO_LOG_LEVEL");
+	args->log_level = static_cast<int>(env_to_uint(v, static_cast<uint32_t>(args->log_level)));
+
 	// String valued env vars need to persist
 	static std::string in_dev, out_dev, client_name;
 
@@ -1215,6 +1586,13 @@ int pw_asio_load_config(struct pw_helper_init_args *args, const char *config_pat
 			else if (key == "buffer_size") args->buffer_size = std::stoi(val);
 			else if (key == "input_channels") args->num_input_channels = std::stoi(val);
 			else if (key == "output_channels") args->num_output_channels = std::stoi(val);
+			else if (key == "input_format") {
+				int format = pw_sample_format_from_string(val.c_str());
+				if (format >= 0) args->input_format = format;
+			} else if (key == "output_format") {
+				int format = pw_sample_format_from_string(val.c_str());
+				if (format >= 0) args->output_format = format;
+			}
 		} else if (section == "devices") {
 			if (key == "input_device") {
 				static std::string in_dev; in_dev = val; args->input_device_name = in_dev.c_str();
@@ -1224,12 +1602,24 @@ int pw_asio_load_config(struct pw_helper_init_args *args, const char *config_pat
 		} else if (section == "performance") {
 			if (key == "rt_priority") args->rt_priority = std::stoi(val);
 			else if (key == "exclusive_mode") args->exclusive_mode = parse_bool(val, false);
+			else if (key == "callback_wakeup") {
+				int wakeup = pw_handoff_wakeup_from_string(val.c_str());
+				if (wakeup >= 0) args->callback_wakeup = wakeup;
+			} else if (key == "callback_spin_us") args->callback_spin_us = std::stoi(val);
+			else if (key == "direct_dispatch") args->direct_dispatch = parse_bool(val, false);
+			else if (key == "zero_copy") args->zero_copy = parse_bool(val, false);
+			else if (key == "hugepages") args->hugepages = parse_bool(val, false);
+			else if (key == "stats") args->stats = parse_bool(val, true);
+			else if (key == "late_policy") {
+				int policy = pw_cycle_late_policy_from_string(val.c_str());
+				if (policy >= 0) args->late_policy = policy;
+			} else if (key == "force_graph_clock") args->force_graph_clock = parse_bool(val, true);
+			else if (key == "interleaved_ports") args->interleaved_ports = parse_bool(val, false);
 		} else if (section == "advanced") {
 			if (key == "client_name") {
 				static std::string cname; cname = val; args->client_name = cname.c_str();
-			} else if (key == "debug_logging") {
-				// Not used in args, but could be handled here if needed
-			}
+			} else if (key == "debug_logging") args->debug_logging = parse_bool(val, false);
+			else if (key == "log_level") args->log_level = std::stoi(val);
 		}
 	}
 
@@ -1262,7 +1652,9 @@ int pw_asio_save_config(const struct pw_helper_init_args *args, const char *conf
 	f << "sample_rate = " << args->sample_rate << "\n";
 	f << "buffer_size = " << args->buffer_size << "\n";
 	f << "input_channels = " << args->num_input_channels << "\n";
-	f << "output_channels = " << args->num_output_channels << "\n\n";
+	f << "output_channels = " << args->num_output_channels << "\n";
+	f << "input_format = " << pw_sample_format_name(static_cast<enum pw_sample_format>(args->input_format)) << "\n";
+	f << "output_format = " << pw_sample_format_name(static_cast<enum pw_sample_format>(args->output_format)) << "\n\n";
 	
 	f << "[devices]\n";
 	f << "input_device = " << (args->input_device_name ? args->input_device_name : "") << "\n";
@@ -1271,11 +1663,21 @@ int pw_asio_save_config(const struct pw_helper_init_args *args, const char *conf
 	
 	f << "[performance]\n";
 	f << "rt_priority = " << args->rt_priority << "\n";
-	f << "exclusive_mode = " << (args->exclusive_mode ? "true" : "false") << "\n\n";
+	f << "exclusive_mode = " << (args->exclusive_mode ? "true" : "false") << "\n";
+	f << "callback_wakeup = " << pw_handoff_wakeup_name(static_cast<enum pw_handoff_wakeup>(args->callback_wakeup)) << "\n";
+	f << "callback_spin_us = " << args->callback_spin_us << "\n";
+	f << "direct_dispatch = " << (args->direct_dispatch ? "true" : "false") << "\n";
+	f << "zero_copy = " << (args->zero_copy ? "true" : "false") << "\n";
+	f << "hugepages = " << (args->hugepages ? "true" : "false") << "\n";
+	f << "stats = " << (args->stats ? "true" : "false") << "\n";
+	f << "late_policy = " << pw_cycle_late_policy_name(static_cast<enum pw_cycle_late_policy>(args->late_policy)) << "\n";
+	f << "force_graph_clock = " << (args->force_graph_clock ? "true" : "false") << "\n";
+	f << "interleaved_ports = " << (args->interleaved_ports ? "true" : "false") << "\n\n";
 	
 	f << "[advanced]\n";
 	f << "client_name = " << (args->client_name ? args->client_name : "") << "\n";
-	f << "debug_logging = false\n";
+	f << "debug_logging = " << (args->debug_logging ? "true" : "false") << "\n";
+	f << "log_level = " << args->log_level << "\n";
 	
 	return f.good() ? 0 : -3;
 }
@@ -1293,6 +1695,18 @@ void set_device_callback(Helper *helper, DeviceCallback callback) {
 	helper->unlock();
 }
 
+void add_settings_listener(Helper *helper, SettingsCallback callback, void *userdata, uint32_t *quantum, uint32_t *rate) {
+	std::lock_guard<std::mutex> lock(helper->settings_mutex);
+	helper->settings_listeners.emplace_back(callback, userdata);
+	*quantum = helper->settings_quantum;
+	*rate = helper->settings_rate;
+}
+
+void remove_settings_listener(Helper *helper, SettingsCallback callback, void *userdata) {
+	std::lock_guard<std::mutex> lock(helper->settings_mutex);
+	std::erase(helper->settings_listeners, std::make_pair(callback, userdata));
+}
+
 } // namespace PwHelper
 
 extern "C" {
@@ -1358,4 +1772,25 @@ int user_pw_wait_for_filter_state(struct user_pw_helper *helper, struct pw_filte
 	return h->wait_for_filter_state_transition(filter, target_state, timeout_ms) ? 1 : 0;
 }
 
+int user_pw_node_get_params(struct user_pw_helper *helper, struct pw_node *node, uint32_t id,
+                            struct spa_pod **params, int max, int timeout_ms) {
+	if (!helper || !node)
+		return -EINVAL;
+	return PwHelper::get_node_params(reinterpret_cast<PwHelper::Helper *>(helper), node, id, params, max, timeout_ms);
+}
+
+void user_pw_notify_filter_state(struct user_pw_helper *helper) {
+	PwHelper::Helper *h = reinterpret_cast<PwHelper::Helper *>(helper);
+	h->notify_filter_state_changed();
+}
+
+void user_pw_add_settings_listener(struct user_pw_helper *helper, user_pw_settings_callback_t cb, void *userdata,
+                                   uint32_t *quantum, uint32_t *rate) {
+	PwHelper::add_settings_listener(reinterpret_cast<PwHelper::Helper *>(helper), cb, userdata, quantum, rate);
+}
+
+void user_pw_remove_settings_listener(struct user_pw_helper *helper, user_pw_settings_callback_t cb, void *userdata) {
+	PwHelper::remove_settings_listener(reinterpret_cast<PwHelper::Helper *>(helper), cb, userdata);
+}
+
 } // extern "C"
@@ -23,9 +23,15 @@ void destroy_helper(Helper *helper);
 std::vector<struct pw_node *> enumerate_pipewire_endpoints(Helper *helper);
 struct pw_node *get_default_node(Helper *helper, enum spa_direction direction);
 struct pw_node *find_node_by_name(Helper *helper, char const *name);
+struct pw_node *find_node_by_serial(Helper *helper, uint64_t serial);
+struct pw_node *find_node_by_id(Helper *helper, uint32_t id);
 
 // Enhanced node property access
 void get_node_props(Helper *helper, struct pw_node *proxy, std::vector<std::pair<std::string_view, std::string*> > const& props);
+// Params are fetched on demand: the first call for an id subscribes to it and
+// waits one server roundtrip. Copies up to `max` params (free() each) and
+// returns how many were copied, or -errno.
+int get_node_params(Helper *helper, struct pw_node *node, uint32_t id, struct spa_pod **out, int max, int timeout_ms);
 
 // Stream management
 struct pw_filter *create_filter(Helper *helper, const char *name, struct pw_properties *props);
@@ -51,4 +57,12 @@ const char *get_last_error(Helper *helper);
 typedef std::function<void(struct pw_node *node, bool added)> DeviceCallback;
 void set_device_callback(Helper *helper, DeviceCallback callback);
 
+// Graph clock from the "settings" metadata: clock.force-quantum and
+// clock.force-rate when set, clock.quantum and clock.rate otherwise, 0 while
+// unknown. Listeners are called on the loop thread when either changes.
+// Adding one also returns the current values, which the first call changes.
+typedef void (*SettingsCallback)(uint32_t quantum, uint32_t rate, void *userdata);
+void add_settings_listener(Helper *helper, SettingsCallback callback, void *userdata, uint32_t *quantum, uint32_t *rate);
+void remove_settings_listener(Helper *helper, SettingsCallback callback, void *userdata);
+
 }
@@ -31,8 +31,27 @@ enum pw_op_type {
 struct user_pw_helper *user_pw_create_helper(int argc, char **argv, struct pw_helper_init_args const *conf);
 void user_pw_destroy_helper(struct user_pw_helper *helper);
 
+// Process-wide helper for the driver. The first acquire connects, later ones
+// reuse the connection; it stays connected after the last release until
+// user_pw_shutdown_shared_helper() is called.
+struct user_pw_helper *user_pw_acquire_helper(struct pw_helper_init_args const *conf);
+void user_pw_release_helper(struct user_pw_helper *helper);
+void user_pw_shutdown_shared_helper(void);
+
 struct pw_node *user_pw_get_default_node(struct user_pw_helper *helper, enum spa_direction direction);
+// Node lookups are hash lookups. Right after the helper is created they wait
+// (bounded) until the registry has been read and every node sent its info.
 struct pw_node *user_pw_find_node_by_name(struct user_pw_helper *helper, char const *name);
+struct pw_node *user_pw_find_node_by_serial(struct user_pw_helper *helper, uint64_t serial);
+struct pw_node *user_pw_find_node_by_id(struct user_pw_helper *helper, uint32_t id);
+
+// Params of a node (SPA_PARAM_*) are fetched on demand. The first call for an
+// id subscribes to it and waits up to timeout_ms for one server roundtrip;
+// later calls return the cached, server-updated copy. Fills up to `max`
+// entries of `params` (free() each) and returns how many, or -errno. Must not
+// be called with the loop locked.
+int user_pw_node_get_params(struct user_pw_helper *helper, struct pw_node *node, uint32_t id,
+                            struct spa_pod **params, int max, int timeout_ms);
 
 void user_pw_lock_loop(struct user_pw_helper *helper);
 void user_pw_unlock_loop(struct user_pw_helper *helper);
@@ -44,6 +63,18 @@ void user_pw_set_device_callback(struct user_pw_helper *helper,
                                  user_pw_device_callback_t cb,
                                  void *userdata);
 
+// Graph clock from the "settings" metadata: clock.force-quantum and
+// clock.force-rate when set, clock.quantum and clock.rate otherwise, 0 while
+// unknown. Listeners are called on the loop thread whenever either changes;
+// removing one waits for a call in progress. Adding one stores the current
+// values in `quantum` and `rate` before the first call can run, so they are
+// the baseline the calls change.
+typedef void (*user_pw_settings_callback_t)(uint32_t quantum, uint32_t rate, void *userdata);
+
+void user_pw_add_settings_listener(struct user_pw_helper *helper, user_pw_settings_callback_t cb, void *userdata,
+                                   uint32_t *quantum, uint32_t *rate);
+void user_pw_remove_settings_listener(struct user_pw_helper *helper, user_pw_settings_callback_t cb, void *userdata);
+
 // Worker thread management for deferred operations
 int user_pw_schedule_work(struct user_pw_helper *helper, enum pw_op_type operation, void *userdata);
 
@@ -54,6 +85,8 @@ void user_pw_set_worker_callback(pw_worker_callback_t callback);
 // Event processing and filter state management
 void user_pw_trigger_event_processing(struct user_pw_helper *helper);
 int user_pw_wait_for_filter_state(struct user_pw_helper *helper, struct pw_filter *filter, enum pw_filter_state target_state, int timeout_ms);
+// Call from the filter's state_changed event to wake user_pw_wait_for_filter_state()
+void user_pw_notify_filter_state(struct user_pw_helper *helper);
 
 // Endpoint enumeration for GUI library
 struct pw_node **user_pw_enumerate_endpoints(struct user_pw_helper *helper, int *count);
@@ -14,6 +14,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "pw_asio_log.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +50,30 @@ struct pw_helper_init_args {
 	bool exclusive_mode;
 	int rt_priority;
 	const char *config_file_path;
+
+	/// How the data thread wakes the ASIO callback thread (enum pw_handoff_wakeup).
+	int callback_wakeup;
+	/// Spin budget before sleeping, for the "spin" wakeup.
+	uint32_t callback_spin_us;
+	/// Run bufferSwitch on the PipeWire data thread instead of marshalling it.
+	bool direct_dispatch;
+	/// Hand the mapped PipeWire output buffers to the host instead of copying.
+	bool zero_copy;
+	/// Back the ASIO buffer arena with huge pages when available.
+	bool hugepages;
+	/// Publish live statistics in /dev/shm for pipewine-stat.
+	bool stats;
+	/// What the outputs play when the host misses a deadline (enum pw_cycle_late_policy).
+	int late_policy;
+	/// Force the graph quantum and rate to the host's buffer size and sample rate
+	/// instead of only asking for them.
+	bool force_graph_clock;
+	/// One interleaved port per direction for all channels instead of one
+	/// mono port per channel.
+	bool interleaved_ports;
+	/// Sample format of the host's input and output buffers (enum pw_sample_format).
+	int input_format;
+	int output_format;
 	
 	// Debug logging configuration
 	bool debug_logging;
@@ -61,16 +87,6 @@ struct pw_helper_init_args {
 #define PW_ASIO_DEFAULT_OUTPUT_CHANNELS 16
 #define PW_ASIO_MIN_BUFFER_SIZE         16
 #define PW_ASIO_MAX_BUFFER_SIZE         8192
-#define PW_ASIO_DEFAULT_LOG_LEVEL       1  // Warning level by default
-
-// Logging levels
-enum pw_asio_log_level {
-    PW_ASIO_LOG_ERROR = 0,
-    PW_ASIO_LOG_WARNING = 1,
-    PW_ASIO_LOG_INFO = 2,
-    PW_ASIO_LOG_DEBUG = 3,
-    PW_ASIO_LOG_TRACE = 4
-};
 
 // Error codes
 enum pw_asio_error {
@@ -98,18 +114,6 @@ bool pw_asio_is_valid_sample_rate(uint32_t rate);
 // Environment variable overrides
 void pw_asio_apply_env_overrides(struct pw_helper_init_args *args);
 
-// Logging functions
-void pw_asio_set_log_level(int level);
-int pw_asio_get_log_level(void);
-void pw_asio_log(int level, const char *function, int line, const char *format, ...);
-
-// Logging macros
-#define PWASIO_LOG_ERROR(format, ...) pw_asio_log(PW_ASIO_LOG_ERROR, __func__, __LINE__, format, ##__VA_ARGS__)
-#define PWASIO_LOG_WARNING(format, ...) pw_asio_log(PW_ASIO_LOG_WARNING, __func__, __LINE__, format, ##__VA_ARGS__)
-#define PWASIO_LOG_INFO(format, ...) pw_asio_log(PW_ASIO_LOG_INFO, __func__, __LINE__, format, ##__VA_ARGS__)
-#define PWASIO_LOG_DEBUG(format, ...) pw_asio_log(PW_ASIO_LOG_DEBUG, __func__, __LINE__, format, ##__VA_ARGS__)
-#define PWASIO_LOG_TRACE(format, ...) pw_asio_log(PW_ASIO_LOG_TRACE, __func__, __LINE__, format, ##__VA_ARGS__)
-
 #ifdef __cplusplus
 }
 #endif
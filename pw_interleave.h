@@ -0,0 +1,130 @@
+#pragma once
+
+/*
+ * Conversion between one interleaved F32 buffer, channel `n` at sample `n` of
+ * every frame, and per-channel planar buffers, for the interleaved port mode
+ * (see pw_cycle.h).
+ *
+ * With SSE, four channels are moved at a time: four frames of them are loaded
+ * as four vectors, transposed in registers and stored as four runs of one
+ * channel each. Channels that do not fill a group of four, and groups with a
+ * channel to skip, go one sample at a time.
+ *
+ * This file has no Wine or PipeWire dependencies so that it can be built into
+ * native tools (see bench/).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void pw_deinterleave_channel(float *dst, float const *src, uint32_t n_channels, uint32_t n_frames) {
+	for (uint32_t frame = 0; frame < n_frames; ++frame)
+		dst[frame] = src[(size_t)frame * n_channels];
+}
+
+static inline void pw_interleave_channel(float *dst, float const *src, uint32_t n_channels, uint32_t n_frames) {
+	if (src) {
+		for (uint32_t frame = 0; frame < n_frames; ++frame)
+			dst[(size_t)frame * n_channels] = src[frame];
+	} else {
+		for (uint32_t frame = 0; frame < n_frames; ++frame)
+			dst[(size_t)frame * n_channels] = 0.0f;
+	}
+}
+
+/// Split `n_frames` frames of `n_channels` interleaved channels into
+/// `dst[channel]`. Channels whose `dst` is NULL are skipped.
+static inline void pw_deinterleave(float *const *dst, float const *src, uint32_t n_channels, uint32_t n_frames) {
+	uint32_t channel = 0;
+
+#ifdef __SSE__
+	for (; channel + 4 <= n_channels; channel += 4) {
+		float *d0 = dst[channel], *d1 = dst[channel + 1], *d2 = dst[channel + 2], *d3 = dst[channel + 3];
+		float const *s = src + channel;
+		size_t stride = n_channels;
+		uint32_t frame = 0;
+
+		if (!d0 || !d1 || !d2 || !d3) {
+			for (int idx = 0; idx < 4; ++idx) {
+				if (dst[channel + idx])
+					pw_deinterleave_channel(dst[channel + idx], s + idx, n_channels, n_frames);
+			}
+			continue;
+		}
+		for (; frame + 4 <= n_frames; frame += 4, s += 4 * stride) {
+			__m128 r0 = _mm_loadu_ps(s);
+			__m128 r1 = _mm_loadu_ps(s + stride);
+			__m128 r2 = _mm_loadu_ps(s + 2 * stride);
+			__m128 r3 = _mm_loadu_ps(s + 3 * stride);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(d0 + frame, r0);
+			_mm_storeu_ps(d1 + frame, r1);
+			_mm_storeu_ps(d2 + frame, r2);
+			_mm_storeu_ps(d3 + frame, r3);
+		}
+		for (; frame < n_frames; ++frame, s += stride) {
+			d0[frame] = s[0];
+			d1[frame] = s[1];
+			d2[frame] = s[2];
+			d3[frame] = s[3];
+		}
+	}
+#endif
+	for (; channel < n_channels; ++channel) {
+		if (dst[channel])
+			pw_deinterleave_channel(dst[channel], src + channel, n_channels, n_frames);
+	}
+}
+
+/// Merge `src[channel]` into `n_frames` frames of `n_channels` interleaved
+/// channels. Channels whose `src` is NULL get silence.
+static inline void pw_interleave(float *dst, float const *const *src, uint32_t n_channels, uint32_t n_frames) {
+	uint32_t channel = 0;
+
+#ifdef __SSE__
+	for (; channel + 4 <= n_channels; channel += 4) {
+		float const *s0 = src[channel], *s1 = src[channel + 1], *s2 = src[channel + 2], *s3 = src[channel + 3];
+		float *d = dst + channel;
+		size_t stride = n_channels;
+		uint32_t frame = 0;
+
+		if (!s0 || !s1 || !s2 || !s3) {
+			for (int idx = 0; idx < 4; ++idx)
+				pw_interleave_channel(d + idx, src[channel + idx], n_channels, n_frames);
+			continue;
+		}
+		for (; frame + 4 <= n_frames; frame += 4, d += 4 * stride) {
+			__m128 r0 = _mm_loadu_ps(s0 + frame);
+			__m128 r1 = _mm_loadu_ps(s1 + frame);
+			__m128 r2 = _mm_loadu_ps(s2 + frame);
+			__m128 r3 = _mm_loadu_ps(s3 + frame);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(d, r0);
+			_mm_storeu_ps(d + stride, r1);
+			_mm_storeu_ps(d + 2 * stride, r2);
+			_mm_storeu_ps(d + 3 * stride, r3);
+		}
+		for (; frame < n_frames; ++frame, d += stride) {
+			d[0] = s0[frame];
+			d[1] = s1[frame];
+			d[2] = s2[frame];
+			d[3] = s3[frame];
+		}
+	}
+#endif
+	for (; channel < n_channels; ++channel)
+		pw_interleave_channel(dst + channel, src[channel], n_channels, n_frames);
+}
+
+#ifdef __cplusplus
+}
+#endif
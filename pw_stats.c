@@ -0,0 +1,184 @@
+#include "pw_stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WINDOW_MASK (PW_STATS_WINDOW - 1)
+#define READ_ATTEMPTS 64
+
+_Static_assert((PW_STATS_WINDOW & WINDOW_MASK) == 0, "PW_STATS_WINDOW must be a power of two");
+
+static uint32_t instance_count;
+
+int pw_stats_create(struct pw_stats *stats, char const *client_name) {
+    struct pw_stats_segment *segment;
+    size_t size = sizeof *segment;
+    int fd, res;
+
+    stats->segment = NULL;
+    snprintf(stats->path, sizeof stats->path, PW_STATS_DIR "/" PW_STATS_NAME_PREFIX "%d.%u",
+             (int)getpid(), __atomic_fetch_add(&instance_count, 1, __ATOMIC_RELAXED));
+
+    if ((fd = open(stats->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) < 0)
+        return -errno;
+    if (ftruncate(fd, size) < 0) {
+        res = -errno;
+        close(fd);
+        unlink(stats->path);
+        return res;
+    }
+    segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    res = segment == MAP_FAILED ? -errno : 0;
+    close(fd);
+    if (res < 0) {
+        unlink(stats->path);
+        return res;
+    }
+    /* Best effort, keeps the first writes from faulting on the data thread */
+    mlock(segment, size);
+
+    segment->version = PW_STATS_VERSION;
+    segment->size = size;
+    segment->pid = getpid();
+    snprintf(segment->client_name, sizeof segment->client_name, "%s", client_name ? client_name : "");
+    /* Readers check the magic last */
+    __atomic_store_n(&segment->magic, PW_STATS_MAGIC, __ATOMIC_RELEASE);
+
+    stats->segment = segment;
+    return 0;
+}
+
+void pw_stats_destroy(struct pw_stats *stats) {
+    if (!stats->segment)
+        return;
+    munmap(stats->segment, sizeof *stats->segment);
+    unlink(stats->path);
+    stats->segment = NULL;
+}
+
+void pw_stats_publish(struct pw_stats_segment *segment, struct pw_stats_cycle const *cycle) {
+    struct pw_stats_counters *c = &segment->counters;
+    uint32_t seq = segment->seq;
+    uint32_t slot = c->cycles & WINDOW_MASK;
+
+    __atomic_store_n(&segment->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    c->cycles++;
+    c->xruns += cycle->xrun;
+    c->callbacks += cycle->callbacks;
+    c->callback_overruns += cycle->callback_overruns;
+    c->deadline_misses += cycle->deadline_misses;
+    c->skipped_buffers += cycle->skipped_buffers;
+    c->marshal_wait_ns += cycle->marshal_wait_ns;
+    if (cycle->marshal_wait_max_ns > c->marshal_wait_max_ns)
+        c->marshal_wait_max_ns = cycle->marshal_wait_max_ns;
+    c->host_ns += cycle->host_ns;
+    if (cycle->host_max_ns > c->host_max_ns)
+        c->host_max_ns = cycle->host_max_ns;
+    c->cycle_ns += cycle->process_ns;
+    c->clock_nsec = cycle->clock_nsec;
+    c->quantum = cycle->quantum;
+    c->rate = cycle->rate;
+    c->rate_diff = cycle->rate_diff;
+    c->cycle_window[slot] = cycle->process_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)cycle->process_ns;
+    c->host_window[slot] = cycle->host_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)cycle->host_ns;
+
+    __atomic_store_n(&segment->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int pw_stats_attach(char const *path, struct pw_stats_segment const **segment) {
+    struct pw_stats_segment const *mapped;
+    struct stat st;
+    int fd, res = 0;
+
+    *segment = NULL;
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0) {
+        res = -errno;
+    } else if ((size_t)st.st_size < sizeof *mapped) {
+        res = -EPROTO;
+    } else {
+        mapped = mmap(NULL, sizeof *mapped, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+            res = -errno;
+    }
+    close(fd);
+    if (res < 0)
+        return res;
+
+    if (__atomic_load_n(&mapped->magic, __ATOMIC_ACQUIRE) != PW_STATS_MAGIC ||
+        mapped->version != PW_STATS_VERSION || mapped->size != sizeof *mapped) {
+        munmap((void *)mapped, sizeof *mapped);
+        return -EPROTO;
+    }
+    *segment = mapped;
+    return 0;
+}
+
+void pw_stats_detach(struct pw_stats_segment const *segment) {
+    if (segment)
+        munmap((void *)segment, sizeof *segment);
+}
+
+int pw_stats_read(struct pw_stats_segment const *segment, struct pw_stats_counters *counters) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        uint32_t begin = __atomic_load_n(&segment->seq, __ATOMIC_ACQUIRE);
+        if (!(begin & 1)) {
+            memcpy(counters, &segment->counters, sizeof *counters);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&segment->seq, __ATOMIC_RELAXED) == begin)
+                return 0;
+        }
+        /* Let the writer finish its update */
+        sched_yield();
+    }
+    return -EAGAIN;
+}
+
+void pw_stats_read_histogram(struct pw_stats_segment const *segment, enum pw_stats_histogram_id id,
+                             struct pw_stats_histogram *hist) {
+    struct pw_stats_histogram const *src = &segment->histograms[id];
+
+    hist->count = 0;
+    hist->max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+    for (uint32_t idx = 0; idx < PW_STATS_BUCKETS; ++idx) {
+        hist->buckets[idx] = __atomic_load_n(&src->buckets[idx], __ATOMIC_RELAXED);
+        hist->count += hist->buckets[idx];
+    }
+}
+
+uint64_t pw_stats_percentile(struct pw_stats_histogram const *hist, double p) {
+    uint64_t rank, seen = 0;
+
+    if (!hist->count)
+        return 0;
+    rank = (uint64_t)(p * hist->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    for (uint32_t idx = 0; idx < PW_STATS_BUCKETS; ++idx) {
+        seen += hist->buckets[idx];
+        if (seen >= rank) {
+            uint64_t high = pw_stats_bucket_high(idx) - 1;
+            return high < hist->max ? high : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+char const *pw_stats_histogram_name(enum pw_stats_histogram_id id) {
+    switch (id) {
+        case PW_STATS_HIST_CYCLE: return "process cycle";
+        case PW_STATS_HIST_WAKEUP: return "callback wakeup";
+        case PW_STATS_HIST_HOST: return "host bufferSwitch";
+        case PW_STATS_HIST_JITTER: return "cycle interval jitter";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+/*
+ * Live statistics of one driver instance, published in a shared memory
+ * segment so that tools/pipewine-stat can watch a running host.
+ *
+ * The segment is a file in /dev/shm named PW_STATS_NAME_PREFIX<pid>.<n>. The
+ * data thread is its only writer and updates it once per graph cycle under a
+ * sequence lock: the sequence is odd while an update is in progress, and
+ * readers retry until they copied the counters between two equal, even
+ * values. Writing takes no locks and no syscalls; readers never block the
+ * writer.
+ *
+ * The segment also holds log-bucketed latency histograms in the style of
+ * HdrHistogram: 16 linear sub-buckets per power of two, so every bucket is
+ * within 6.25% of the values it counts, from 1 ns up to 4.3 s. They are
+ * updated with plain relaxed stores by the same single writer, outside the
+ * sequence lock, so a reader may see a bucket one event ahead of another.
+ *
+ * This file has no Wine or PipeWire dependencies so that it can be built into
+ * native tools (see tools/ and bench/).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PW_STATS_MAGIC 0x54535750u /* "PWST" */
+#define PW_STATS_VERSION 3
+#define PW_STATS_DIR "/dev/shm"
+#define PW_STATS_NAME_PREFIX "pipewine-stat."
+/// Number of recent cycles kept for percentiles, a power of two.
+#define PW_STATS_WINDOW 1024
+
+#define PW_STATS_SUB_BUCKET_BITS 4
+#define PW_STATS_SUB_BUCKETS (1u << PW_STATS_SUB_BUCKET_BITS)
+/// Enough buckets for every 32 bit value; larger ones go in the last.
+#define PW_STATS_BUCKETS ((32 - PW_STATS_SUB_BUCKET_BITS + 1) * PW_STATS_SUB_BUCKETS)
+
+enum pw_stats_histogram_id {
+	/// Whole process callback.
+	PW_STATS_HIST_CYCLE = 0,
+	/// From posting a marshalled callback to the host being called.
+	PW_STATS_HIST_WAKEUP,
+	/// Host bufferSwitch, one entry per call.
+	PW_STATS_HIST_HOST,
+	/// Distance of the interval between two process callbacks from the
+	/// graph period.
+	PW_STATS_HIST_JITTER,
+
+	PW_STATS_HIST_COUNT
+};
+
+/// Values in ns.
+struct pw_stats_histogram {
+	uint64_t count;
+	uint64_t max;
+	uint64_t buckets[PW_STATS_BUCKETS];
+};
+
+struct pw_stats_counters {
+	/// Graph cycles seen while running.
+	uint64_t cycles;
+	/// Cycles whose graph position did not follow on from the previous one.
+	uint64_t xruns;
+	/// bufferSwitch calls, and those that took longer than one period.
+	uint64_t callbacks;
+	uint64_t callback_overruns;
+	/// Marshalled bufferSwitch calls not done by the cycle deadline, and
+	/// ASIO buffers skipped because the host was still busy with one.
+	uint64_t deadline_misses;
+	uint64_t skipped_buffers;
+	/// Time the data thread waited for marshalled callbacks, total and longest.
+	uint64_t marshal_wait_ns;
+	uint64_t marshal_wait_max_ns;
+	/// Time spent in the host's bufferSwitch, total and longest.
+	uint64_t host_ns;
+	uint64_t host_max_ns;
+	/// Time spent in the process callback, total.
+	uint64_t cycle_ns;
+
+	/// Graph clock of the last cycle.
+	uint64_t clock_nsec;
+	uint32_t quantum;
+	uint32_t rate;
+	double rate_diff;
+
+	/// Process and host time of the last PW_STATS_WINDOW cycles in ns, the
+	/// entry of cycle `n` at n % PW_STATS_WINDOW.
+	uint32_t cycle_window[PW_STATS_WINDOW];
+	uint32_t host_window[PW_STATS_WINDOW];
+};
+
+struct pw_stats_segment {
+	uint32_t magic;
+	uint32_t version;
+	/// sizeof(struct pw_stats_segment) of the writer.
+	uint32_t size;
+	int32_t pid;
+	char client_name[64];
+
+	uint32_t seq __attribute__((aligned(64)));
+	struct pw_stats_counters counters __attribute__((aligned(64)));
+
+	struct pw_stats_histogram histograms[PW_STATS_HIST_COUNT] __attribute__((aligned(64)));
+};
+
+/// What one graph cycle adds to the counters.
+struct pw_stats_cycle {
+	uint64_t process_ns;
+	uint64_t host_ns;
+	uint64_t host_max_ns;
+	uint64_t marshal_wait_ns;
+	uint64_t marshal_wait_max_ns;
+	uint32_t callbacks;
+	uint32_t callback_overruns;
+	uint32_t deadline_misses;
+	uint32_t skipped_buffers;
+	bool xrun;
+
+	uint64_t clock_nsec;
+	uint32_t quantum;
+	uint32_t rate;
+	double rate_diff;
+};
+
+static inline uint32_t pw_stats_bucket(uint64_t value) {
+	uint32_t shift;
+
+	if (value < PW_STATS_SUB_BUCKETS)
+		return (uint32_t)value;
+	if (value > UINT32_MAX)
+		value = UINT32_MAX;
+	shift = 31 - __builtin_clz((uint32_t)value) - PW_STATS_SUB_BUCKET_BITS;
+	return ((shift + 1) << PW_STATS_SUB_BUCKET_BITS) + (uint32_t)((value >> shift) & (PW_STATS_SUB_BUCKETS - 1));
+}
+
+/// Smallest value counted in `bucket`.
+static inline uint64_t pw_stats_bucket_low(uint32_t bucket) {
+	uint32_t shift;
+
+	if (bucket < PW_STATS_SUB_BUCKETS)
+		return bucket;
+	shift = (bucket >> PW_STATS_SUB_BUCKET_BITS) - 1;
+	return (uint64_t)(PW_STATS_SUB_BUCKETS + (bucket & (PW_STATS_SUB_BUCKETS - 1))) << shift;
+}
+
+/// One past the largest value counted in `bucket`.
+static inline uint64_t pw_stats_bucket_high(uint32_t bucket) {
+	if (bucket < PW_STATS_SUB_BUCKETS)
+		return bucket + 1;
+	return pw_stats_bucket_low(bucket) + (1ull << ((bucket >> PW_STATS_SUB_BUCKET_BITS) - 1));
+}
+
+/// Count `value` in a histogram. Data thread only.
+static inline void pw_stats_record(struct pw_stats_segment *segment, enum pw_stats_histogram_id id, uint64_t value) {
+	struct pw_stats_histogram *hist = &segment->histograms[id];
+	uint64_t *bucket = &hist->buckets[pw_stats_bucket(value)];
+
+	__atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&hist->count, hist->count + 1, __ATOMIC_RELAXED);
+	if (value > hist->max)
+		__atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+}
+
+/// Writer side handle.
+struct pw_stats {
+	struct pw_stats_segment *segment;
+	char path[96];
+};
+
+/// Create and map a new segment for this process. Returns 0 or a negative
+/// errno; `stats->segment` stays NULL on failure.
+int pw_stats_create(struct pw_stats *stats, char const *client_name);
+/// Unmap and remove the segment.
+void pw_stats_destroy(struct pw_stats *stats);
+
+/// Add one cycle to the counters. Data thread only.
+void pw_stats_publish(struct pw_stats_segment *segment, struct pw_stats_cycle const *cycle);
+
+/// Reader side: map the segment at `path` read-only. Returns 0 or a
+/// negative errno (-EPROTO when it is not a compatible segment).
+int pw_stats_attach(char const *path, struct pw_stats_segment const **segment);
+void pw_stats_detach(struct pw_stats_segment const *segment);
+
+/// Reader side: consistent copy of the counters. Returns 0, or -EAGAIN when
+/// the writer kept updating them during every attempt.
+int pw_stats_read(struct pw_stats_segment const *segment, struct pw_stats_counters *counters);
+
+/// Reader side: copy of one histogram; `count` is the sum of the copied
+/// buckets.
+void pw_stats_read_histogram(struct pw_stats_segment const *segment, enum pw_stats_histogram_id id,
+		struct pw_stats_histogram *hist);
+
+/// Bucket-resolution value below which a fraction `p` of the counted
+/// values lie, never more than the maximum. 0 for an empty histogram.
+uint64_t pw_stats_percentile(struct pw_stats_histogram const *hist, double p);
+
+/// Short name of a histogram for display.
+char const *pw_stats_histogram_name(enum pw_stats_histogram_id id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,313 @@
+/*
+ * Live view of the statistics segments published by running PipeWine driver
+ * instances (see pw_stats.h).
+ *
+ * Without -p it lists the segments in /dev/shm and, if exactly one belongs to
+ * a live process, watches that one. Every interval it prints one line with
+ * the cycle rate, new xruns, host overruns, missed callback deadlines and
+ * skipped buffers, the graph clock, the DSP load
+ * (mean process time over the period) and the median, 99th percentile and
+ * maximum of the process and bufferSwitch times of the cycles since the
+ * previous line (up to the last PW_STATS_WINDOW of them).
+ *
+ * With -H it dumps the latency histograms instead: every non-empty bucket
+ * with its count and cumulative share, and the percentiles up to 99.99% and
+ * the maximum, which is where the rare outliers behind a click show up. By
+ * default they cover the whole life of the instance; with -i only what was
+ * recorded during that interval.
+ *
+ * Usage: pipewine-stat [-l] [-c] [-H] [-p pid[.n]] [-i interval_ms] [-n count]
+ *   -l  list segments and exit
+ *   -c  remove segments left behind by processes that no longer exist
+ *   -H  dump the histograms and exit
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pw_stats.h"
+
+#define MAX_SEGMENTS 64
+
+struct found {
+    char path[sizeof(PW_STATS_DIR) + 256];
+    char id[256];
+    int pid;
+    bool alive;
+};
+
+static volatile sig_atomic_t interrupted;
+
+static void on_signal(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+static int compare_u32(void const *a, void const *b) {
+    uint32_t x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+    return x < y ? -1 : x > y;
+}
+
+static bool process_alive(int pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static int find_segments(struct found *found, int max) {
+    size_t prefix = strlen(PW_STATS_NAME_PREFIX);
+    struct dirent *entry;
+    DIR *dir;
+    int count = 0;
+
+    if (!(dir = opendir(PW_STATS_DIR)))
+        return -errno;
+    while ((entry = readdir(dir)) && count < max) {
+        if (strncmp(entry->d_name, PW_STATS_NAME_PREFIX, prefix))
+            continue;
+        snprintf(found[count].path, sizeof found[count].path, PW_STATS_DIR "/%s", entry->d_name);
+        snprintf(found[count].id, sizeof found[count].id, "%s", entry->d_name + prefix);
+        found[count].pid = atoi(found[count].id);
+        found[count].alive = found[count].pid > 0 && process_alive(found[count].pid);
+        ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+static void list_segments(struct found const *found, int count) {
+    printf("%-12s %-8s %s\n", "id", "state", "client");
+    for (int idx = 0; idx < count; ++idx) {
+        struct pw_stats_segment const *segment;
+        int res = pw_stats_attach(found[idx].path, &segment);
+
+        printf("%-12s %-8s %s\n", found[idx].id, found[idx].alive ? "running" : "dead",
+               res < 0 ? strerror(-res) : segment->client_name);
+        pw_stats_detach(segment);
+    }
+}
+
+static void clean_segments(struct found const *found, int count) {
+    for (int idx = 0; idx < count; ++idx) {
+        if (found[idx].alive)
+            continue;
+        if (unlink(found[idx].path) < 0)
+            fprintf(stderr, "%s: %s\n", found[idx].path, strerror(errno));
+        else
+            printf("removed %s\n", found[idx].path);
+    }
+}
+
+/* Sort the window entries of cycles from..to-1 into `out`, returns how many */
+static uint32_t collect_window(uint32_t const *window, uint64_t from, uint64_t to, uint32_t *out) {
+    uint64_t first = to - from > PW_STATS_WINDOW ? to - PW_STATS_WINDOW : from;
+    uint32_t count = 0;
+
+    for (uint64_t cycle = first; cycle < to; ++cycle)
+        out[count++] = window[cycle % PW_STATS_WINDOW];
+    qsort(out, count, sizeof *out, compare_u32);
+    return count;
+}
+
+static double percentile_us(uint32_t const *sorted, uint32_t count, double p) {
+    if (!count)
+        return 0.0;
+    return sorted[(uint32_t)(p * (count - 1) + 0.5)] / 1000.0;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_histogram(enum pw_stats_histogram_id id, struct pw_stats_histogram const *hist) {
+    static double const points[] = { 0.5, 0.9, 0.99, 0.999, 0.9999 };
+    uint64_t seen = 0;
+
+    printf("\n%s: %llu values", pw_stats_histogram_name(id), (unsigned long long)hist->count);
+    if (!hist->count) {
+        putchar('\n');
+        return;
+    }
+    for (size_t idx = 0; idx < sizeof points / sizeof *points; ++idx)
+        printf(", p%g %.1f us", points[idx] * 100.0, pw_stats_percentile(hist, points[idx]) / 1000.0);
+    printf(", max %.1f us\n", hist->max / 1000.0);
+
+    printf("%14s %14s %12s %9s\n", "from us", "to us", "count", "cum%");
+    for (uint32_t bucket = 0; bucket < PW_STATS_BUCKETS; ++bucket) {
+        if (!hist->buckets[bucket])
+            continue;
+        seen += hist->buckets[bucket];
+        printf("%14.3f %14.3f %12llu %9.4f\n", pw_stats_bucket_low(bucket) / 1000.0,
+               pw_stats_bucket_high(bucket) / 1000.0, (unsigned long long)hist->buckets[bucket],
+               100.0 * seen / hist->count);
+    }
+}
+
+static int dump_histograms(char const *path, int interval_ms) {
+    static struct pw_stats_histogram before[PW_STATS_HIST_COUNT], after;
+    struct pw_stats_segment const *segment;
+    int res;
+
+    if ((res = pw_stats_attach(path, &segment)) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-res));
+        return 1;
+    }
+    printf("%s (pid %d, %s)\n", path, segment->pid, segment->client_name);
+
+    if (interval_ms > 0) {
+        struct timespec interval = { interval_ms / 1000, (long)(interval_ms % 1000) * 1000000L };
+        for (int id = 0; id < PW_STATS_HIST_COUNT; ++id)
+            pw_stats_read_histogram(segment, id, &before[id]);
+        nanosleep(&interval, NULL);
+        printf("recorded during %d ms; max is over the whole run\n", interval_ms);
+    }
+
+    for (int id = 0; id < PW_STATS_HIST_COUNT; ++id) {
+        pw_stats_read_histogram(segment, id, &after);
+        after.count -= before[id].count;
+        for (uint32_t bucket = 0; bucket < PW_STATS_BUCKETS; ++bucket)
+            after.buckets[bucket] -= before[id].buckets[bucket];
+        print_histogram(id, &after);
+    }
+
+    pw_stats_detach(segment);
+    return 0;
+}
+
+static int watch(char const *path, int interval_ms, long count) {
+    static struct pw_stats_counters prev, cur;
+    static uint32_t sorted[PW_STATS_WINDOW];
+    struct pw_stats_segment const *segment;
+    struct timespec interval = { interval_ms / 1000, (long)(interval_ms % 1000) * 1000000L };
+    uint64_t prev_ns, now_ns;
+    int res, lines = 0;
+
+    if ((res = pw_stats_attach(path, &segment)) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-res));
+        return 1;
+    }
+    printf("%s (pid %d, %s)\n", path, segment->pid, segment->client_name);
+
+    if ((res = pw_stats_read(segment, &prev)) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-res));
+        pw_stats_detach(segment);
+        return 1;
+    }
+    prev_ns = monotonic_ns();
+
+    while (!interrupted && (count < 0 || count-- > 0)) {
+        uint64_t cycles, callbacks;
+        uint32_t n;
+        double period_ns, load, wait_us;
+
+        nanosleep(&interval, NULL);
+        if (interrupted)
+            break;
+        if (pw_stats_read(segment, &cur) < 0)
+            continue;
+        now_ns = monotonic_ns();
+
+        if (lines++ % 20 == 0)
+            printf("%9s %6s %6s %6s %6s %7s %6s %10s %6s %25s %25s %9s\n", "cycles/s", "xruns", "overr", "late",
+                   "skip", "quantum", "rate", "rate_diff", "load%", "process p50/p99/max us", "host p50/p99/max us",
+                   "wait us");
+
+        cycles = cur.cycles - prev.cycles;
+        callbacks = cur.callbacks - prev.callbacks;
+        period_ns = cur.rate ? (double)cur.quantum * 1e9 / cur.rate : 0.0;
+        load = cycles && period_ns > 0.0 ? 100.0 * (double)(cur.cycle_ns - prev.cycle_ns) / cycles / period_ns : 0.0;
+        wait_us = callbacks ? (double)(cur.marshal_wait_ns - prev.marshal_wait_ns) / callbacks / 1000.0 : 0.0;
+
+        printf("%9.1f %6llu %6llu %6llu %6llu %7u %6u %10.6f %6.1f", cycles * 1e9 / (now_ns - prev_ns),
+               (unsigned long long)(cur.xruns - prev.xruns),
+               (unsigned long long)(cur.callback_overruns - prev.callback_overruns),
+               (unsigned long long)(cur.deadline_misses - prev.deadline_misses),
+               (unsigned long long)(cur.skipped_buffers - prev.skipped_buffers),
+               cur.quantum, cur.rate, cur.rate_diff, load);
+        n = collect_window(cur.cycle_window, prev.cycles, cur.cycles, sorted);
+        printf("   %7.1f/%7.1f/%7.1f", percentile_us(sorted, n, 0.5), percentile_us(sorted, n, 0.99),
+               percentile_us(sorted, n, 1.0));
+        n = collect_window(cur.host_window, prev.cycles, cur.cycles, sorted);
+        printf("   %7.1f/%7.1f/%7.1f", percentile_us(sorted, n, 0.5), percentile_us(sorted, n, 0.99),
+               percentile_us(sorted, n, 1.0));
+        printf(" %9.1f\n", wait_us);
+        fflush(stdout);
+
+        prev = cur;
+        prev_ns = now_ns;
+    }
+
+    pw_stats_detach(segment);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static struct found found[MAX_SEGMENTS];
+    char const *id = NULL;
+    char const *path = NULL;
+    bool list = false, clean = false, histograms = false;
+    int interval_ms = 0;
+    long count = -1;
+    int n_found, opt;
+
+    while ((opt = getopt(argc, argv, "lcHp:i:n:")) != -1) {
+        switch (opt) {
+            case 'l': list = true; break;
+            case 'c': clean = true; break;
+            case 'H': histograms = true; break;
+            case 'p': id = optarg; break;
+            case 'i': interval_ms = atoi(optarg); break;
+            case 'n': count = atol(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-l] [-c] [-H] [-p pid[.n]] [-i interval_ms] [-n count]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (interval_ms < 0) {
+        fprintf(stderr, "interval must be positive\n");
+        return 2;
+    }
+
+    if ((n_found = find_segments(found, MAX_SEGMENTS)) < 0) {
+        fprintf(stderr, PW_STATS_DIR ": %s\n", strerror(-n_found));
+        return 1;
+    }
+    if (clean) {
+        clean_segments(found, n_found);
+        return 0;
+    }
+    if (list) {
+        list_segments(found, n_found);
+        return 0;
+    }
+
+    /* "1234" picks the only segment of that process, "1234.1" an exact one */
+    for (int idx = 0, matches = 0; idx < n_found; ++idx) {
+        bool match = id ? !strcmp(found[idx].id, id) || (!strchr(id, '.') && found[idx].pid == atoi(id))
+                        : found[idx].alive;
+        if (match && ++matches == 1)
+            path = found[idx].path;
+        else if (match)
+            path = NULL;
+    }
+    if (!path) {
+        if (n_found)
+            list_segments(found, n_found);
+        else
+            fprintf(stderr, "no driver instances found in " PW_STATS_DIR "\n");
+        fprintf(stderr, "select one instance with -p\n");
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    if (histograms)
+        return dump_histograms(path, interval_ms);
+    return watch(path, interval_ms ? interval_ms : 1000, count);
+}